@@ -0,0 +1,109 @@
+#include <encode.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// QR size report: encodes receipt-like JSON payloads with every charset and prints the
+// smallest QR version (error correction level M) that holds each token. Base64 and
+// Base70 tokens contain lowercase letters and are stored in byte mode (8 bits per
+// character); Base45 ("PQ") tokens fit the alphanumeric mode (5.5 bits per character).
+//
+// Usage: uqpack_bench_qr [none|lz4|zstd|brotli]
+
+namespace {
+    // Data codewords per QR version at error correction level M (ISO/IEC 18004 table 7)
+    const int dataCodewordsM[40] = {
+        16, 28, 44, 64, 86, 108, 124, 154, 182, 216,
+        254, 290, 334, 365, 415, 453, 507, 563, 627, 669,
+        714, 782, 860, 914, 1000, 1062, 1128, 1193, 1267, 1373,
+        1455, 1541, 1631, 1725, 1812, 1914, 1992, 2102, 2216, 2334
+    };
+
+    bool isAlphanumeric(const std::string& token) {
+        return std::all_of(token.begin(), token.end(), [](char c) {
+            return std::string("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:").find(c) != std::string::npos;
+        });
+    }
+
+    // Bits of a single-segment QR payload for the given version
+    int segmentBits(size_t length, bool alphanumeric, int version) {
+        const int sizeClass = version <= 9 ? 0 : version <= 26 ? 1 : 2;
+        const int countBits = alphanumeric ? (sizeClass == 0 ? 9 : sizeClass == 1 ? 11 : 13)
+                                           : (sizeClass == 0 ? 8 : 16);
+        const int dataBits = alphanumeric ? static_cast<int>(11 * (length / 2) + 6 * (length % 2))
+                                          : static_cast<int>(8 * length);
+        return 4 + countBits + dataBits;
+    }
+
+    // Smallest version holding the token, 0 if it does not fit in version 40
+    int qrVersion(const std::string& token) {
+        const bool alphanumeric = isAlphanumeric(token);
+        for (int version = 1; version <= 40; version++) {
+            if (segmentBits(token.size(), alphanumeric, version) <= 8 * dataCodewordsM[version - 1]) {
+                return version;
+            }
+        }
+        return 0;
+    }
+
+    // Same bytes encode(json) produces, without its progress output
+    std::vector<std::uint8_t> compress(const json& document, UQPack::CompressionType compressionType) {
+        const std::vector<std::uint8_t> packed = json::to_msgpack(document);
+        switch (compressionType) {
+            case UQPack::CompressionType::LZ4:
+                return UQPack::compressWithLZ4(packed.data(), packed.size());
+            case UQPack::CompressionType::ZSTD:
+                return UQPack::compressWithZstd(packed.data(), packed.size());
+            case UQPack::CompressionType::BROTLI:
+                return UQPack::compressWithBrotli(packed.data(), packed.size());
+            default:
+                return packed;
+        }
+    }
+
+    json receipt(int items) {
+        json document = {
+            {"reference", "35d93b66"},
+            {"transaction", {{"amount", "339"}, {"currencyCode", "USD"}}}
+        };
+        for (int i = 0; i < items; i++) {
+            document["items"].push_back({
+                {"sku", "SKU-" + std::to_string(10000 + 37 * i)},
+                {"name", "Item number " + std::to_string(i)},
+                {"qty", 1 + i % 3},
+                {"price", std::to_string(199 + 50 * i)}
+            });
+        }
+        return document;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    UQPack::CompressionType compressionType = UQPack::CompressionType::ZSTD;
+    if (argc >= 2) {
+        const std::string arg = argv[1];
+        if (arg == "none") {
+            compressionType = UQPack::CompressionType::NONE;
+        } else if (arg == "lz4") {
+            compressionType = UQPack::CompressionType::LZ4;
+        } else if (arg == "brotli") {
+            compressionType = UQPack::CompressionType::BROTLI;
+        }
+    }
+
+    const char* const names[] = {"Base64", "Base70", "Base45"};
+    std::cout << "items  charset  chars  mode   version  modules" << std::endl;
+    for (int items : {0, 2, 5, 10, 20}) {
+        const std::vector<std::uint8_t> payload = compress(receipt(items), compressionType);
+        for (int baseIndex = 0; baseIndex < 3; baseIndex++) {
+            const std::string token = UQPack::encode(payload, compressionType, baseIndex);
+            const int version = qrVersion(token);
+            std::cout << items << "\t" << names[baseIndex] << "\t " << token.size() << "\t"
+                      << (isAlphanumeric(token) ? "alnum" : "byte") << "\t" << version << "\t"
+                      << (version ? std::to_string(17 + 4 * version) + "x" + std::to_string(17 + 4 * version) : "-")
+                      << std::endl;
+        }
+    }
+    return 0;
+}
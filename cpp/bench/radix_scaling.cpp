@@ -0,0 +1,73 @@
+#include <base.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// Scaling benchmark for the parallel radix conversion: converts a random payload to
+// basesCharSet[1] (which has no bit-packing shortcut) and back with 1..N threads and
+// reports the speedup over the serial path.
+//
+// Usage: uqpack_bench_radix [payload_kib] [max_threads]
+
+namespace {
+    template<typename F>
+    double bestOfMillis(int runs, F&& f) {
+        double best = 0;
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = (i == 0) ? elapsed : std::min(best, elapsed);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const size_t payloadKiB = argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned maxThreads = argc >= 3 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : hardwareThreads;
+
+    std::mt19937 rng(42);
+    std::vector<std::uint8_t> payload(payloadKiB * 1024);
+    for (auto& byte : payload) {
+        byte = static_cast<std::uint8_t>(rng());
+    }
+    const std::string& charset = UQPack::basesCharSet[1];
+
+    // Warm the power table cache so every run measures conversion only
+    const std::string reference = UQPack::convertToBase(payload, charset);
+
+    std::cout << "payload " << payloadKiB << " KiB, " << reference.size() << " digits, "
+              << hardwareThreads << " hardware threads" << std::endl;
+    std::cout << "threads  encode_ms  speedup  decode_ms  speedup" << std::endl;
+
+    double serialEncode = 0;
+    double serialDecode = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        UQPack::RadixParallelism parallelism;
+        parallelism.threads = threads;
+        parallelism.thresholdBytes = 0;
+
+        std::string encoded;
+        std::vector<std::uint8_t> decoded;
+        double encodeMs = bestOfMillis(3, [&] { encoded = UQPack::convertToBase(payload, charset, parallelism); });
+        double decodeMs = bestOfMillis(3, [&] { decoded = UQPack::convertFromBase(encoded, charset, parallelism); });
+        if (encoded != reference || decoded != UQPack::convertFromBase(reference, charset)) {
+            std::cerr << "Mismatch against the serial result with " << threads << " threads" << std::endl;
+            return 1;
+        }
+        if (threads == 1) {
+            serialEncode = encodeMs;
+            serialDecode = decodeMs;
+        }
+
+        std::cout.precision(2);
+        std::cout << std::fixed << threads << "\t " << encodeMs << "\t    " << serialEncode / encodeMs
+                  << "x\t" << decodeMs << "\t     " << serialDecode / decodeMs << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <encode.hpp>
+#include <decode.hpp>
+#include <common.hpp>
+#include <lz4.h>
+#include <zstd.h>
+#include <brotli/encode.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Session reuse benchmark: compresses and encodes small payloads with the libraries'
+// one-shot functions (which set up a fresh compressor on every call) and with one
+// long-lived Encoder, and reports calls per second for each codec.
+//
+// Usage: uqpack_bench_session [payload_bytes] [iterations]
+
+namespace {
+    template<typename F>
+    double callsPerSecond(int iterations, F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            f();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return iterations / seconds;
+    }
+
+    std::vector<std::uint8_t> compressOneShot(const std::vector<std::uint8_t>& data, UQPack::CompressionType type) {
+        std::vector<std::uint8_t> out;
+        switch (type) {
+            case UQPack::CompressionType::LZ4: {
+                out.resize(4 + LZ4_compressBound(static_cast<int>(data.size())));
+                int size = LZ4_compress_default(reinterpret_cast<const char*>(data.data()), reinterpret_cast<char*>(out.data() + 4),
+                                                static_cast<int>(data.size()), static_cast<int>(out.size() - 4));
+                *reinterpret_cast<std::uint32_t*>(out.data()) = static_cast<std::uint32_t>(data.size());
+                out.resize(4 + size);
+                break;
+            }
+            case UQPack::CompressionType::ZSTD:
+                out.resize(ZSTD_compressBound(data.size()));
+                out.resize(ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 1));
+                break;
+            default: {
+                // The stream follows the original size as a varint, as in compressWithBrotli
+                UQPack::internal::appendVarint(out, data.size());
+                const size_t prefix = out.size();
+                size_t size = BrotliEncoderMaxCompressedSize(data.size());
+                out.resize(prefix + size);
+                BrotliEncoderCompress(11, BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE, data.size(), data.data(), &size, out.data() + prefix);
+                out.resize(prefix + size);
+                break;
+            }
+        }
+        return out;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const size_t payloadBytes = argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    const int iterations = argc >= 3 ? std::atoi(argv[2]) : 2000;
+
+    // Mildly compressible payload, like a small MessagePack document
+    std::mt19937 rng(42);
+    std::vector<std::uint8_t> payload(payloadBytes);
+    for (auto& byte : payload) {
+        byte = static_cast<std::uint8_t>('a' + rng() % 16);
+    }
+
+    const char* const names[] = {"lz4", "zstd", "brotli"};
+    const UQPack::CompressionType types[] = {UQPack::CompressionType::LZ4, UQPack::CompressionType::ZSTD, UQPack::CompressionType::BROTLI};
+
+    std::cout << "payload " << payloadBytes << " bytes, " << iterations << " iterations" << std::endl;
+    std::cout << "codec   one-shot/s  session/s  speedup" << std::endl;
+    for (int c = 0; c < 3; c++) {
+        UQPack::EncodeOptions options;
+        options.compressionType = types[c];
+        options.baseIndex = 0;
+
+        UQPack::Encoder encoder;
+        const std::string token = encoder.encode(encoder.compress(payload.data(), payload.size(), types[c]), options);
+        UQPack::CompressionType compressionType;
+        if (token != UQPack::encode(compressOneShot(payload, types[c]), options) ||
+            UQPack::decodeInternal(token, compressionType) != payload) {
+            std::cerr << "Session output differs from the one-shot path for " << names[c] << std::endl;
+            return 1;
+        }
+
+        double oneShot = callsPerSecond(iterations, [&] {
+            UQPack::encode(compressOneShot(payload, types[c]), options);
+        });
+        double session = callsPerSecond(iterations, [&] {
+            encoder.encode(encoder.compress(payload.data(), payload.size(), types[c]), options);
+        });
+
+        std::cout.precision(0);
+        std::cout << std::fixed << names[c] << "\t" << oneShot << "\t    " << session << "\t";
+        std::cout.precision(2);
+        std::cout << session / oneShot << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <encode.hpp>
+#include <decode.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Small-payload codec comparison: compresses receipt-like JSON payloads with each codec
+// on one long-lived Encoder and decodes the tokens with one Decoder into a reused
+// buffer, and reports the average token length and encode and decode calls per second.
+// Tokens use automatic base selection, as encode(json) does.
+//
+// Usage: uqpack_bench_codecs [iterations]
+
+namespace {
+    template<typename F>
+    double callsPerSecond(int iterations, F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            f();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return iterations / seconds;
+    }
+
+    json receipt(int items) {
+        json document = {
+            {"reference", "35d93b66"},
+            {"transaction", {{"amount", "339"}, {"currencyCode", "USD"}}}
+        };
+        for (int i = 0; i < items; i++) {
+            document["items"].push_back({
+                {"sku", "SKU-" + std::to_string(10000 + 37 * i)},
+                {"name", "Item number " + std::to_string(i)},
+                {"qty", 1 + i % 3},
+                {"price", std::to_string(199 + 50 * i)}
+            });
+        }
+        return document;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc >= 2 ? std::atoi(argv[1]) : 2000;
+
+    std::vector<std::vector<std::uint8_t>> payloads;
+    size_t totalBytes = 0;
+    for (int items : {0, 1, 2, 3, 5, 8, 10, 15, 20}) {
+        payloads.push_back(json::to_msgpack(receipt(items)));
+        totalBytes += payloads.back().size();
+    }
+
+    const char* const names[] = {"lz4", "lz4hc", "zstd", "brotli", "deflate"};
+    const UQPack::CompressionType types[] = {UQPack::CompressionType::LZ4, UQPack::CompressionType::LZ4HC, UQPack::CompressionType::ZSTD,
+                                             UQPack::CompressionType::BROTLI, UQPack::CompressionType::DEFLATE};
+
+    std::cout << payloads.size() << " payloads, " << totalBytes / payloads.size() << " bytes on average, "
+              << iterations << " iterations" << std::endl;
+    std::cout << "codec    chars   encode/s  decode/s" << std::endl;
+    for (int c = 0; c < 5; c++) {
+        UQPack::EncodeOptions options;
+        options.compressionType = types[c];
+
+        UQPack::Encoder encoder;
+        UQPack::Decoder decoder;
+        std::vector<std::string> tokens;
+        size_t totalLength = 0;
+        std::vector<std::uint8_t> buffer;
+        for (const auto& payload : payloads) {
+            tokens.push_back(encoder.encode(encoder.compress(payload.data(), payload.size(), options), options));
+            totalLength += tokens.back().size();
+            decoder.decodeInto(tokens.back(), buffer);
+            if (buffer != payload) {
+                std::cerr << "Round trip failed for " << names[c] << std::endl;
+                return 1;
+            }
+        }
+
+        size_t next = 0;
+        double encodes = callsPerSecond(iterations, [&] {
+            const auto& payload = payloads[next++ % payloads.size()];
+            encoder.encode(encoder.compress(payload.data(), payload.size(), options), options);
+        });
+        next = 0;
+        double decodes = callsPerSecond(iterations, [&] {
+            decoder.decodeInto(tokens[next++ % tokens.size()], buffer);
+        });
+
+        std::cout.precision(1);
+        std::cout << std::fixed << names[c] << "\t " << static_cast<double>(totalLength) / tokens.size() << "\t";
+        std::cout.precision(0);
+        std::cout << encodes << "\t    " << decodes << std::endl;
+    }
+    return 0;
+}
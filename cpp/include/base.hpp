@@ -1,15 +1,30 @@
 #ifndef BASE_H
 #define BASE_H
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <boost/multiprecision/cpp_int.hpp>
+#include <common.hpp>
 
 namespace UQPack {
+    // Digits of the built-in URL-safe character sets
+    inline constexpr char base64UrlDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    inline constexpr char base70Digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_.~";
+    inline constexpr char base45Digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
     // Define our URL-safe character sets.
     const std::vector<std::string> basesCharSet = {
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_",         // Base64 URL-safe
-        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_.~"         // Base70
+        base64UrlDigits,         // Base64 URL-safe
+        base70Digits,            // Base70
+        base45Digits             // Base45 (QR alphanumeric, see base45.hpp)
     };
 
     // Convert a uint64_t to a base64 string
@@ -27,72 +42,679 @@ namespace UQPack {
         return result;
     }
 
-    // Convert a number to a string using the specified base charset
-    inline std::string convertToBase(const std::vector<std::uint8_t>& digits, const std::string& charset) {
-        const int base = charset.length();
-        std::string result;
-        result.reserve(digits.size() * 2); // Pre-allocate to avoid reallocations
-        
-        // Convert bytes to a single large integer
-        boost::multiprecision::cpp_int value = 0;
-        for (auto it = digits.begin(); it != digits.end(); ++it) {
-            value = (value << 8) | *it;
+    namespace internal {
+        using BigInt = boost::multiprecision::cpp_int;
+
+        // Widest native unsigned integer; payloads that fit skip the bignum engine
+        #ifdef __SIZEOF_INT128__
+        using SmallInt = unsigned __int128;
+        #else
+        using SmallInt = std::uint64_t;
+        #endif
+
+        // Largest L with base^L representable in a uint64_t, and base^L itself
+        constexpr unsigned wordDigits(unsigned base) {
+            unsigned digits = 0;
+            for (std::uint64_t power = 1; power <= UINT64_MAX / base; power *= base) {
+                digits++;
+            }
+            return digits;
         }
-        
-        // Convert to the target base
-        if (value == 0) {
-            result.push_back(charset[0]);
-        } else {
+
+        constexpr std::uint64_t wordPower(unsigned base) {
+            std::uint64_t power = 1;
+            for (unsigned i = wordDigits(base); i > 0; i--) {
+                power *= base;
+            }
+            return power;
+        }
+
+        // Call f with the base as a std::integral_constant for the built-in charsets so
+        // divisions by it compile to multiplications; other bases are passed as 0 and
+        // the callee falls back to the runtime value.
+        template <typename F>
+        inline decltype(auto) withRadix(unsigned base, F&& f) {
+            switch (base) {
+                case 64:
+                    return f(std::integral_constant<unsigned, 64>());
+                case 66:
+                    return f(std::integral_constant<unsigned, 66>());
+                default:
+                    return f(std::integral_constant<unsigned, 0>());
+            }
+        }
+
+        // Digit value for every byte, -1 for bytes outside the charset, plus an ASCII
+        // validity bitmap laid out for the vectorized pre-scan: lowNibbleRows[c & 0xF]
+        // has bit (c >> 4) set when c is in the charset.
+        struct DigitTable {
+            std::int8_t values[256] = {};
+            std::uint8_t lowNibbleRows[16] = {};
+            bool asciiOnly = true;
+
+            constexpr DigitTable(const char* digits, size_t base) {
+                for (size_t i = 0; i < 256; i++) {
+                    values[i] = -1;
+                }
+                for (size_t i = 0; i < base; i++) {
+                    const unsigned char c = static_cast<unsigned char>(digits[i]);
+                    values[c] = static_cast<std::int8_t>(i);
+                    if (c < 0x80) {
+                        lowNibbleRows[c & 0xF] |= static_cast<std::uint8_t>(1u << (c >> 4));
+                    } else {
+                        asciiOnly = false;
+                    }
+                }
+            }
+
+            explicit DigitTable(const std::string& charset) : DigitTable(charset.data(), charset.length()) {}
+
+            constexpr int operator[](char c) const {
+                return values[static_cast<unsigned char>(c)];
+            }
+        };
+
+        // Bytes per block in the fixed-width block encoding
+        constexpr unsigned blockBytes = 8;
+
+        // Smallest number of base digits that can hold any value of the given byte width
+        constexpr unsigned blockDigits(unsigned base, unsigned bytes) {
+            const std::uint64_t maxValue = bytes >= 8 ? UINT64_MAX : (std::uint64_t(1) << (8 * bytes)) - 1;
+            unsigned digits = 0;
+            std::uint64_t power = 1; // base^digits
+            while (power <= maxValue) {
+                digits++;
+                if (power > maxValue / base) {
+                    break;
+                }
+                power *= base;
+            }
+            return digits;
+        }
+
+        constexpr size_t digitCount(const char* digits) {
+            size_t count = 0;
+            while (digits[count] != '\0') {
+                count++;
+            }
+            return count;
+        }
+
+        constexpr bool hasDistinctDigits(const char* digits, size_t base) {
+            for (size_t i = 0; i < base; i++) {
+                for (size_t j = i + 1; j < base; j++) {
+                    if (digits[i] == digits[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    /**
+     * Alphabet: a character set described at compile time.
+     * The lookup table, validity bitmap and digits-per-word constants are generated by
+     * the compiler, and the conversion routines specialized on an Alphabet use its base
+     * as a constant, so custom alphabets get the same code as the built-in ones:
+     *
+     *     inline constexpr char base62Digits[] = "0123456789ABC...xyz";
+     *     using Base62Alphabet = UQPack::Alphabet<base62Digits>;
+     *     std::string token = UQPack::convertToBase<Base62Alphabet>(bytes);
+     *
+     * @tparam Digits Null-terminated digits with static storage duration, lowest first
+     */
+    template <const char* Digits>
+    struct Alphabet {
+        static constexpr const char* digits = Digits;
+        static constexpr unsigned base = static_cast<unsigned>(internal::digitCount(Digits));
+        static_assert(base >= 2 && base <= 127, "Alphabet needs between 2 and 127 digits");
+        static_assert(internal::hasDistinctDigits(Digits, base), "Alphabet digits must be distinct");
+
+        // Digits that fit in a uint64_t word, and digits per 8-byte block in block mode
+        static constexpr unsigned wordDigits = internal::wordDigits(base);
+        static constexpr unsigned blockDigits = internal::blockDigits(base, internal::blockBytes);
+
+        static constexpr internal::DigitTable table = internal::DigitTable(Digits, base);
+    };
+
+    using Base64UrlAlphabet = Alphabet<base64UrlDigits>;
+    using Base70Alphabet = Alphabet<base70Digits>;
+    using Base45Alphabet = Alphabet<base45Digits>;
+
+    namespace internal {
+
+        // Tables are built once per charset and live for the whole process. The
+        // built-in charsets are matched first without taking a lock.
+        inline const DigitTable& digitTable(const std::string& charset) {
+            if (charset == base64UrlDigits) {
+                return Base64UrlAlphabet::table;
+            }
+            if (charset == base70Digits) {
+                return Base70Alphabet::table;
+            }
+
+            static std::mutex mutex;
+            static std::map<std::string, std::unique_ptr<const DigitTable>> custom;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_ptr<const DigitTable>& entry = custom[charset];
+            if (!entry) {
+                entry.reset(new DigitTable(charset));
+            }
+            return *entry;
+        }
+
+        // True if every byte of str is in the charset. Uses SSE4.1 or AVX2 when the CPU
+        // supports them, so malformed tokens are rejected before any conversion work.
+        bool isValidDigits(const char* str, size_t size, const DigitTable& table);
+
+        // Write word as at least minDigits digits ending just before end; returns the
+        // first digit written.
+        template <unsigned Radix>
+        inline char* writeWord(std::uint64_t word, unsigned base, const char* charset, char* end, unsigned minDigits) {
+            const unsigned radix = Radix ? Radix : base;
+            unsigned written = 0;
             do {
-                boost::multiprecision::cpp_int quotient;
-                boost::multiprecision::cpp_int remainder;
-                
-                boost::multiprecision::divide_qr(value, boost::multiprecision::cpp_int(base), quotient, remainder);
-                result.push_back(charset[static_cast<int>(remainder)]);
-                value = quotient;
-                
-            } while (value > 0);
+                *--end = charset[word % radix];
+                word /= radix;
+                written++;
+            } while (word > 0 || written < minDigits);
+            return end;
         }
 
-        std::reverse(result.begin(), result.end());
+        // Register-only conversion for payloads that fit in a SmallInt. Values above
+        // 64 bits drop one word-sized group of digits per 128-bit division; the rest
+        // runs on uint64_t.
+        template <unsigned Radix>
+        inline std::string smallToBase(SmallInt value, unsigned base, const char* charset) {
+            const unsigned radix = Radix ? Radix : base;
+            const unsigned leafDigits = wordDigits(radix);
+            const std::uint64_t leafPower = wordPower(radix);
 
-        return result;
+            char buffer[3 * 64];
+            char* const end = buffer + sizeof(buffer);
+            char* begin = end;
+            while (value > UINT64_MAX) {
+                begin = writeWord<Radix>(static_cast<std::uint64_t>(value % leafPower), radix, charset, begin, leafDigits);
+                value /= leafPower;
+            }
+            begin = writeWord<Radix>(static_cast<std::uint64_t>(value), radix, charset, begin, 1);
+            return std::string(begin, end);
+        }
+
+        // Register-only parse of a pre-validated string; returns false if the value does
+        // not fit in a SmallInt
+        template <unsigned Radix>
+        inline bool smallFromBase(const std::string& str, unsigned base, const DigitTable& table, SmallInt& value) {
+            const unsigned radix = Radix ? Radix : base;
+            const unsigned leafDigits = wordDigits(radix);
+
+            value = 0;
+            size_t pos = 0;
+            while (pos < str.size()) {
+                // Gather up to one word of digits before touching the wide accumulator
+                const size_t count = std::min<size_t>(leafDigits, str.size() - pos);
+                std::uint64_t chunk = 0;
+                std::uint64_t scale = 1;
+                for (size_t i = 0; i < count; i++) {
+                    chunk = chunk * radix + static_cast<unsigned>(table[str[pos + i]]);
+                    scale *= radix;
+                }
+                pos += count;
+
+                if (__builtin_mul_overflow(value, static_cast<SmallInt>(scale), &value) ||
+                    __builtin_add_overflow(value, static_cast<SmallInt>(chunk), &value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // One entry of the radix power table: base^(leafDigits * 2^k) plus its Barrett
+        // reciprocal, so splitting a number by it costs two multiplications instead of a
+        // long division.
+        struct RadixPower {
+            BigInt value;
+            BigInt reciprocal; // floor(2^(2 * bits) / value)
+            unsigned bits;     // bit length of value
+        };
+
+        // Cached powers of a single base used by the divide-and-conquer converter.
+        struct RadixPowers {
+            unsigned base;
+            unsigned leafDigits; // largest L with base^L representable in a uint64_t
+            std::vector<RadixPower> levels;
+        };
+
+        // floor(2^(2 * bits) / value) for a value of the given bit length. Large values
+        // take one Newton step from the reciprocal of their top half, so building the
+        // table costs multiplications rather than a long division per level.
+        inline BigInt barrettReciprocal(const BigInt& value, unsigned bits) {
+            if (bits <= 256) {
+                return (BigInt(1) << (2 * bits)) / value;
+            }
+
+            const unsigned headBits = bits / 2 + 32;
+            BigInt estimate = barrettReciprocal(value >> (bits - headBits), headBits) << (bits - headBits);
+            estimate = 2 * estimate - ((estimate * estimate * value) >> (2 * bits));
+
+            // The estimate is within a few units; fix it up against the exact remainder
+            BigInt remainder = (BigInt(1) << (2 * bits)) - estimate * value;
+            while (remainder < 0) {
+                remainder += value;
+                --estimate;
+            }
+            while (remainder >= value) {
+                remainder -= value;
+                ++estimate;
+            }
+            return estimate;
+        }
+
+        inline RadixPower makeRadixPower(BigInt value) {
+            RadixPower power;
+            power.bits = static_cast<unsigned>(boost::multiprecision::msb(value)) + 1;
+            power.reciprocal = barrettReciprocal(value, power.bits);
+            power.value = std::move(value);
+            return power;
+        }
+
+        // Return the power table for base with at least levelCount levels.
+        // Tables are cached per base and shared between threads; growing one publishes
+        // a new snapshot so readers holding an older one are never invalidated.
+        inline std::shared_ptr<const RadixPowers> radixPowers(unsigned base, size_t levelCount) {
+            static std::mutex mutex;
+            static std::map<unsigned, std::shared_ptr<const RadixPowers>> cache;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            std::shared_ptr<const RadixPowers>& entry = cache[base];
+            if (entry && entry->levels.size() >= levelCount) {
+                return entry;
+            }
+
+            auto grown = entry ? std::make_shared<RadixPowers>(*entry) : std::make_shared<RadixPowers>();
+            if (grown->levels.empty()) {
+                grown->base = base;
+                grown->leafDigits = wordDigits(base);
+                grown->levels.push_back(makeRadixPower(BigInt(wordPower(base))));
+            }
+            while (grown->levels.size() < levelCount) {
+                const BigInt& last = grown->levels.back().value;
+                grown->levels.push_back(makeRadixPower(last * last));
+            }
+            entry = grown;
+            return entry;
+        }
+
+        // Barrett division: value < divisor.value^2, so the estimate is off by at most two.
+        inline void splitByPower(const BigInt& value, const RadixPower& divisor, BigInt& quotient, BigInt& remainder) {
+            quotient = ((value >> (divisor.bits - 1)) * divisor.reciprocal) >> (divisor.bits + 1);
+            remainder = value - quotient * divisor.value;
+            while (remainder >= divisor.value) {
+                remainder -= divisor.value;
+                ++quotient;
+            }
+        }
+
+        // Levels split off above the serial subtrees of a conversion with this many
+        // tasks: enough to give each task a subtree, never below the leaves
+        inline size_t forkLevels(unsigned tasks, size_t level) {
+            size_t levels = 0;
+            while ((size_t(1) << levels) < tasks && levels < level) {
+                levels++;
+            }
+            return levels;
+        }
+
+        // Write value (< base^(leafDigits * 2^level)) as exactly leafDigits * 2^level
+        // digits, most significant first, zero-padded on the left. With tasks > 1 the
+        // top levels are split breadth-first and the subtrees converted on the shared
+        // worker pool; on a worker everything runs on the calling thread.
+        template <unsigned Radix>
+        inline void writeDigits(const BigInt& value, const RadixPowers& powers, size_t level, const char* charset, char* out, unsigned tasks = 1) {
+            const size_t width = static_cast<size_t>(powers.leafDigits) << level;
+            if (value.is_zero()) {
+                std::fill(out, out + width, charset[0]);
+                return;
+            }
+            if (level == 0) {
+                writeWord<Radix>(static_cast<std::uint64_t>(value), powers.base, charset, out + width, powers.leafDigits);
+                return;
+            }
+
+            const size_t forked = WorkerPool::onWorker() ? 0 : forkLevels(tasks, level);
+            if (forked > 0) {
+                WorkerPool& pool = WorkerPool::shared();
+                std::vector<BigInt> parts(1, value);
+                for (size_t depth = 0; depth < forked; depth++) {
+                    std::vector<BigInt> halves(parts.size() * 2);
+                    const RadixPower& divisor = powers.levels[level - 1 - depth];
+                    pool.forEach(parts.size(), [&](size_t i) {
+                        splitByPower(parts[i], divisor, halves[2 * i], halves[2 * i + 1]);
+                    });
+                    parts.swap(halves);
+                }
+                const size_t subLevel = level - forked;
+                pool.forEach(parts.size(), [&](size_t i) {
+                    writeDigits<Radix>(parts[i], powers, subLevel, charset, out + (width >> forked) * i);
+                });
+                return;
+            }
+
+            BigInt quotient, remainder;
+            splitByPower(value, powers.levels[level - 1], quotient, remainder);
+            writeDigits<Radix>(quotient, powers, level - 1, charset, out);
+            writeDigits<Radix>(remainder, powers, level - 1, charset, out + width / 2);
+        }
+
+        // Inverse of writeDigits: read leafDigits * 2^level digit values, most
+        // significant first, combining word-sized leaves with the cached powers.
+        template <unsigned Radix>
+        inline BigInt readDigits(const std::uint8_t* digits, const RadixPowers& powers, size_t level, unsigned tasks = 1) {
+            if (level == 0) {
+                const unsigned radix = Radix ? Radix : powers.base;
+                std::uint64_t word = 0;
+                for (unsigned i = 0; i < powers.leafDigits; i++) {
+                    word = word * radix + digits[i];
+                }
+                return BigInt(word);
+            }
+
+            const size_t forked = WorkerPool::onWorker() ? 0 : forkLevels(tasks, level);
+            if (forked > 0) {
+                WorkerPool& pool = WorkerPool::shared();
+                const size_t subLevel = level - forked;
+                const size_t subWidth = static_cast<size_t>(powers.leafDigits) << subLevel;
+                std::vector<BigInt> parts(size_t(1) << forked);
+                pool.forEach(parts.size(), [&](size_t i) {
+                    parts[i] = readDigits<Radix>(digits + subWidth * i, powers, subLevel);
+                });
+                for (size_t depth = subLevel; depth < level; depth++) {
+                    std::vector<BigInt> joined(parts.size() / 2);
+                    const BigInt& scale = powers.levels[depth].value;
+                    pool.forEach(joined.size(), [&](size_t i) {
+                        joined[i] = parts[2 * i] * scale + parts[2 * i + 1];
+                    });
+                    parts.swap(joined);
+                }
+                return parts[0];
+            }
+
+            const size_t half = static_cast<size_t>(powers.leafDigits) << (level - 1);
+            BigInt value = readDigits<Radix>(digits, powers, level - 1);
+            if (!value.is_zero()) {
+                value *= powers.levels[level - 1].value;
+            }
+            value += readDigits<Radix>(digits + half, powers, level - 1);
+            return value;
+        }
     }
-    
-    // Convert a string back to bytes using the specified base charset
-    inline std::vector<std::uint8_t> convertFromBase(const std::string& str, const std::string& charset) {
-        const int base = charset.length();
-        
-        // Create value lookup map
-        std::unordered_map<char, int> charToValue;
-        for (int i = 0; i < charset.length(); i++) {
-            charToValue[charset[i]] = i;
+
+    // Fork-join settings for very large conversions. The divide-and-conquer split is cut
+    // into about threads subtrees, converted on the shared worker pool; the result is
+    // identical to the serial path.
+    struct RadixParallelism {
+        unsigned threads = 1;              // 1 keeps the conversion on the calling thread
+        size_t thresholdBytes = 256 * 1024; // payloads smaller than this always run serially
+
+        unsigned tasksFor(size_t bytes) const {
+            return (threads > 1 && bytes >= thresholdBytes) ? threads : 1;
         }
-        
-        // Convert string to large integer
-        boost::multiprecision::cpp_int value = 0;
-        for (char c : str) {
-            if (charToValue.find(c) == charToValue.end()) {
+    };
+
+    namespace internal {
+        // The conversions below are specialized on Radix (the base as a compile-time
+        // constant, or 0 for a runtime base) and read the charset through a plain
+        // pointer, so neither the string nor the Alphabet entry points copy anything.
+
+        template <unsigned Radix>
+        inline std::string toBase(const std::vector<std::uint8_t>& digits, const char* charset, unsigned base, const RadixParallelism& parallelism) {
+            // Short payloads stay in registers; leading zero bytes do not count
+            auto first = std::find_if(digits.begin(), digits.end(), [](std::uint8_t byte) { return byte != 0; });
+            if (static_cast<size_t>(digits.end() - first) <= sizeof(SmallInt)) {
+                SmallInt small = 0;
+                for (auto it = first; it != digits.end(); ++it) {
+                    small = (small << 8) | *it;
+                }
+                return smallToBase<Radix>(small, base, charset);
+            }
+
+            // Convert bytes to a single large integer
+            BigInt value = 0;
+            boost::multiprecision::import_bits(value, first, digits.end(), 8);
+
+            std::shared_ptr<const RadixPowers> powers = radixPowers(base, 1);
+            size_t level = 0;
+            while (powers->levels[level].value <= value) {
+                level++;
+                if (level == powers->levels.size()) {
+                    powers = radixPowers(base, level + 1);
+                }
+            }
+
+            std::string result(static_cast<size_t>(powers->leafDigits) << level, charset[0]);
+            writeDigits<Radix>(value, *powers, level, charset, &result[0], parallelism.tasksFor(digits.size()));
+
+            // Strip the left padding; value is non-zero so at least one digit remains
+            result.erase(0, result.find_first_not_of(charset[0]));
+            return result;
+        }
+
+        template <unsigned Radix>
+        inline std::vector<std::uint8_t> fromBase(const std::string& str, unsigned base, const DigitTable& charToValue, const RadixParallelism& parallelism) {
+            if (!isValidDigits(str.data(), str.size(), charToValue)) {
                 throw std::runtime_error("Invalid character in encoded data");
             }
-            value = value * base + charToValue[c];
+
+            // Short strings are parsed in registers and fall through only on overflow
+            SmallInt small;
+            if (str.size() <= 3 * static_cast<size_t>(wordDigits(base)) && smallFromBase<Radix>(str, base, charToValue, small)) {
+                size_t bytes = 1;
+                while (bytes < sizeof(small) && (small >> (8 * bytes)) != 0) {
+                    bytes++;
+                }
+                std::vector<std::uint8_t> result(bytes);
+                for (size_t i = bytes; i-- > 0;) {
+                    result[i] = static_cast<std::uint8_t>(small);
+                    small >>= 8;
+                }
+                return result;
+            }
+
+            std::shared_ptr<const RadixPowers> powers = radixPowers(base, 1);
+            size_t level = 0;
+            while ((static_cast<size_t>(powers->leafDigits) << level) < str.size()) {
+                level++;
+            }
+            if (level >= powers->levels.size()) {
+                powers = radixPowers(base, level);
+            }
+
+            // Map characters to digit values, left-padded with zeros to the block width
+            const size_t width = static_cast<size_t>(powers->leafDigits) << level;
+            std::vector<std::uint8_t> digitValues(width, 0);
+            std::uint8_t* out = digitValues.data() + (width - str.size());
+            for (char c : str) {
+                *out++ = static_cast<std::uint8_t>(charToValue[c]);
+            }
+
+            // Convert large integer back to bytes
+            // Digits carry roughly 3/4 of a byte each for the built-in bases
+            BigInt value = readDigits<Radix>(digitValues.data(), *powers, level, parallelism.tasksFor(str.size() * 3 / 4));
+            std::vector<std::uint8_t> result;
+            if (value.is_zero()) {
+                // Handle special case for zero
+                result.push_back(0);
+            } else {
+                result.reserve(boost::multiprecision::msb(value) / 8 + 1);
+                boost::multiprecision::export_bits(value, std::back_inserter(result), 8);
+            }
+
+            return result;
         }
-        
-        // Convert large integer back to bytes
-        std::vector<std::uint8_t> result;
-        while (value > 0) {
-            result.push_back(static_cast<std::uint8_t>(value & 0xFF));
-            value >>= 8;
+    }
+
+    // Convert a number to a string using the specified base charset.
+    // The bytes are read as one big-endian integer and split recursively by cached
+    // powers base^(L * 2^k) down to word-sized leaves of L digits.
+    inline std::string convertToBase(const std::vector<std::uint8_t>& digits, const std::string& charset, const RadixParallelism& parallelism = RadixParallelism()) {
+        const unsigned base = static_cast<unsigned>(charset.length());
+        return internal::withRadix(base, [&](auto radix) {
+            return internal::toBase<decltype(radix)::value>(digits, charset.data(), base, parallelism);
+        });
+    }
+
+    // Same conversion with a compile-time alphabet
+    template <typename A>
+    inline std::string convertToBase(const std::vector<std::uint8_t>& digits, const RadixParallelism& parallelism = RadixParallelism()) {
+        return internal::toBase<A::base>(digits, A::digits, A::base, parallelism);
+    }
+    
+    // Convert a string back to bytes using the specified base charset.
+    // Digits are packed into uint64_t leaves and merged pairwise with the same cached
+    // powers the encoder splits by; the result is exported a limb at a time.
+    inline std::vector<std::uint8_t> convertFromBase(const std::string& str, const std::string& charset, const RadixParallelism& parallelism = RadixParallelism()) {
+        const unsigned base = static_cast<unsigned>(charset.length());
+        const internal::DigitTable& charToValue = internal::digitTable(charset);
+        return internal::withRadix(base, [&](auto radix) {
+            return internal::fromBase<decltype(radix)::value>(str, base, charToValue, parallelism);
+        });
+    }
+
+    template <typename A>
+    inline std::vector<std::uint8_t> convertFromBase(const std::string& str, const RadixParallelism& parallelism = RadixParallelism()) {
+        return internal::fromBase<A::base>(str, A::base, A::table, parallelism);
+    }
+
+
+    namespace internal {
+        // Radix is the base as a compile-time constant for the built-in charsets, so
+        // the per-digit division becomes a multiply; 0 falls back to the runtime base.
+        template <unsigned Radix>
+        inline void encodeBlocks(const std::uint8_t* in, size_t size, unsigned base, const char* charset, char* out) {
+            const unsigned radix = Radix ? Radix : base;
+            const unsigned fullDigits = blockDigits(radix, blockBytes);
+            while (size > 0) {
+                const unsigned bytes = size < blockBytes ? static_cast<unsigned>(size) : blockBytes;
+                const unsigned digits = bytes == blockBytes ? fullDigits : blockDigits(radix, bytes);
+                std::uint64_t word = 0;
+                for (unsigned i = 0; i < bytes; i++) {
+                    word = (word << 8) | in[i];
+                }
+                for (unsigned i = digits; i-- > 0;) {
+                    out[i] = charset[word % radix];
+                    word /= radix;
+                }
+                in += bytes;
+                size -= bytes;
+                out += digits;
+            }
         }
-        
-        // Handle special case for zero
-        if (result.empty()) {
-            result.push_back(0);
-        } else {
-            std::reverse(result.begin(), result.end());
+
+        template <unsigned Radix>
+        inline void decodeBlocks(const std::uint8_t* digitValues, size_t size, unsigned base, std::uint8_t* out) {
+            const unsigned radix = Radix ? Radix : base;
+            const unsigned fullDigits = blockDigits(radix, blockBytes);
+            while (size > 0) {
+                const unsigned digits = size < fullDigits ? static_cast<unsigned>(size) : fullDigits;
+                unsigned bytes = blockBytes;
+                while (blockDigits(radix, bytes) != digits) {
+                    bytes--;
+                }
+
+                // Digit strings can exceed the byte width, so reject overflow
+                const std::uint64_t maxValue = bytes >= 8 ? UINT64_MAX : (std::uint64_t(1) << (8 * bytes)) - 1;
+                std::uint64_t word = 0;
+                for (unsigned i = 0; i < digits; i++) {
+                    if (word > (maxValue - digitValues[i]) / radix) {
+                        throw std::runtime_error("Invalid block in encoded data");
+                    }
+                    word = word * radix + digitValues[i];
+                }
+                for (unsigned i = bytes; i-- > 0;) {
+                    out[i] = static_cast<std::uint8_t>(word);
+                    word >>= 8;
+                }
+                digitValues += digits;
+                size -= digits;
+                out += bytes;
+            }
         }
-        
-        return result;
+    }
+
+    // Length of the fixed-width block encoding of size bytes in the given base:
+    // every 8-byte block takes blockDigits(base, 8) digits (11 for bases 62 to 84)
+    // and a trailing partial block of r bytes takes blockDigits(base, r).
+    inline size_t blockEncodedLength(size_t size, unsigned base) {
+        return (size / internal::blockBytes) * internal::blockDigits(base, internal::blockBytes) +
+               internal::blockDigits(base, static_cast<unsigned>(size % internal::blockBytes));
+    }
+
+    namespace internal {
+        template <unsigned Radix>
+        inline std::string toBaseBlocks(const std::vector<std::uint8_t>& data, const char* charset, unsigned base) {
+            std::string result(blockEncodedLength(data.size(), base), charset[0]);
+            if (!result.empty()) {
+                encodeBlocks<Radix>(data.data(), data.size(), base, charset, &result[0]);
+            }
+            return result;
+        }
+
+        template <unsigned Radix>
+        inline std::vector<std::uint8_t> fromBaseBlocks(const std::string& str, unsigned base, const DigitTable& charToValue) {
+            // Recover the byte length from the digit count; trailing partial blocks have a
+            // distinct digit count for every byte width, so anything else is malformed
+            const unsigned fullDigits = blockDigits(base, blockBytes);
+            const unsigned tailDigits = static_cast<unsigned>(str.size() % fullDigits);
+            unsigned tailBytes = 0;
+            while (tailBytes < blockBytes && blockDigits(base, tailBytes) != tailDigits) {
+                tailBytes++;
+            }
+            if (tailBytes == blockBytes) {
+                throw std::runtime_error("Invalid block encoded data length");
+            }
+
+            if (!isValidDigits(str.data(), str.size(), charToValue)) {
+                throw std::runtime_error("Invalid character in encoded data");
+            }
+            std::vector<std::uint8_t> digitValues(str.size());
+            for (size_t i = 0; i < str.size(); i++) {
+                digitValues[i] = static_cast<std::uint8_t>(charToValue[str[i]]);
+            }
+
+            std::vector<std::uint8_t> result((str.size() / fullDigits) * blockBytes + tailBytes);
+            decodeBlocks<Radix>(digitValues.data(), digitValues.size(), base, result.data());
+            return result;
+        }
+    }
+
+    // Convert bytes to a string using fixed-width blocks instead of one big integer.
+    // Blocks are independent, so the cost is linear and every byte, including leading
+    // zeros, is preserved.
+    inline std::string convertToBaseBlocks(const std::vector<std::uint8_t>& data, const std::string& charset) {
+        const unsigned base = static_cast<unsigned>(charset.length());
+        return internal::withRadix(base, [&](auto radix) {
+            return internal::toBaseBlocks<decltype(radix)::value>(data, charset.data(), base);
+        });
+    }
+
+    template <typename A>
+    inline std::string convertToBaseBlocks(const std::vector<std::uint8_t>& data) {
+        return internal::toBaseBlocks<A::base>(data, A::digits, A::base);
+    }
+
+    // Convert a fixed-width block string back to bytes
+    inline std::vector<std::uint8_t> convertFromBaseBlocks(const std::string& str, const std::string& charset) {
+        const unsigned base = static_cast<unsigned>(charset.length());
+        const internal::DigitTable& charToValue = internal::digitTable(charset);
+        return internal::withRadix(base, [&](auto radix) {
+            return internal::fromBaseBlocks<decltype(radix)::value>(str, base, charToValue);
+        });
+    }
+
+    template <typename A>
+    inline std::vector<std::uint8_t> convertFromBaseBlocks(const std::string& str) {
+        return internal::fromBaseBlocks<A::base>(str, A::base, A::table);
     }
 
 }
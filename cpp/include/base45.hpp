@@ -0,0 +1,29 @@
+#ifndef BASE45_H
+#define BASE45_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UQPack {
+    /**
+     * Base45 codec (RFC 9285) for basesCharSet[2].
+     * Every character is in the QR code alphanumeric set, so a token made only of
+     * Base45 digits is stored at 5.5 bits per character instead of 8 in byte mode.
+     * Each pair of bytes becomes three digits, least significant first, and a
+     * trailing single byte becomes two. Unlike convertToBase, every byte (including
+     * leading zeros) is kept and the output length is exactly 3 * (n / 2) + 2 * (n % 2).
+     */
+    std::string convertToBase45(const std::vector<std::uint8_t>& data);
+
+    // Throws std::runtime_error on characters outside basesCharSet[2], on a length
+    // of the form 3k + 1, or on a group whose value does not fit its byte width
+    std::vector<std::uint8_t> convertFromBase45(const std::string& str);
+
+    // Number of characters convertToBase45 produces for size bytes
+    inline size_t base45EncodedLength(size_t size) {
+        return 3 * (size / 2) + 2 * (size % 2);
+    }
+}
+
+#endif // BASE45_H
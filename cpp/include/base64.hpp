@@ -0,0 +1,24 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UQPack {
+    /**
+     * Base64url codec for basesCharSet[0].
+     * Because 64 is a power of two, the big-integer conversion done by convertToBase
+     * reduces to regrouping the payload bits into 6-bit digits aligned to the least
+     * significant end. These functions produce exactly the same digits as
+     * convertToBase/convertFromBase with basesCharSet[0] (leading zero bytes and
+     * digits are dropped, zero is "A") in linear time, using SSE4.1 or AVX2 kernels
+     * when the CPU supports them and a scalar loop otherwise.
+     */
+    std::string convertToBase64Url(const std::vector<std::uint8_t>& data);
+
+    // Throws std::runtime_error if str contains a character outside basesCharSet[0]
+    std::vector<std::uint8_t> convertFromBase64Url(const std::string& str);
+}
+
+#endif // BASE64_H
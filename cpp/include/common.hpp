@@ -1,7 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <siphash.hpp>
 
@@ -10,6 +20,26 @@ namespace UQPack {
 // Public interface for checksum operations
 std::string calculateChecksum(const std::string& input);
 
+// Checksum for QR tokens (see base45.hpp): the same hash rendered as two characters
+// of 0-9A-Z, which stay in the QR alphanumeric set and never contain ':'
+std::string calculateQrChecksum(const std::string& input);
+
+// Incremental form of calculateChecksum for input that arrives in pieces.
+// Feeding the same bytes in any split gives the same checksum as the one-shot call.
+class ChecksumStream {
+public:
+    ChecksumStream();
+
+    void update(const char* data, size_t size);
+    std::string finish() const;
+
+private:
+    uint64_t v0, v1, v2, v3;
+    uint64_t totalSize;
+    unsigned char pending[8];
+    size_t pendingSize;
+};
+
 namespace internal {
     // Internal implementation details
     struct SipHashKey {
@@ -21,6 +51,143 @@ namespace internal {
     
     uint64_t siphash24(const void* data, size_t size, const SipHashKey* key);
     std::string convertToBase64(uint64_t value);
+
+    // Keeps freed blocks for reuse, so codec state that has to be rebuilt on every call
+    // (Brotli has no reset) gets its hash tables and ring buffers back without a trip
+    // to the system allocator. allocate/release match Brotli's brotli_alloc_func and
+    // brotli_free_func with the pool as the opaque pointer. Not thread-safe.
+    class BlockPool {
+    public:
+        BlockPool() : cachedBytes(0) {}
+        ~BlockPool();
+
+        BlockPool(const BlockPool&) = delete;
+        BlockPool& operator=(const BlockPool&) = delete;
+
+        static void* allocate(void* pool, size_t size);
+        static void release(void* pool, void* address);
+
+    private:
+        // Freed blocks beyond this are returned to the system
+        static constexpr size_t maxCachedBytes = 64 * 1024 * 1024;
+
+        std::map<size_t, std::vector<void*>> freeBlocks;
+        size_t cachedBytes;
+    };
+
+    // Little-endian 32-bit sizes, as used by the block frame of compressed payloads
+    inline void storeSize32(std::uint8_t* out, size_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+        }
+    }
+
+    inline std::uint32_t loadSize32(const std::uint8_t* in) {
+        return static_cast<std::uint32_t>(in[0]) | static_cast<std::uint32_t>(in[1]) << 8 |
+               static_cast<std::uint32_t>(in[2]) << 16 | static_cast<std::uint32_t>(in[3]) << 24;
+    }
+
+    // LEB128 lengths, as prefixed to Brotli payloads. The first byte of a non-zero
+    // length is never zero, so the prefix survives the integer conversion, which drops
+    // leading zero bytes.
+    inline void appendVarint(std::vector<std::uint8_t>& out, size_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    // Advances pos past the varint; false if it is truncated or longer than 64 bits
+    inline bool readVarint(const std::uint8_t* in, size_t size, size_t& pos, std::uint64_t& value) {
+        value = 0;
+        for (int shift = 0; pos < size && shift < 64; shift += 7) {
+            const std::uint8_t byte = in[pos++];
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Fixed set of worker threads for codec work split across cores. The threads live
+    // as long as the pool, so their Encoder::local() and Decoder::local() sessions stay
+    // warm between calls, which threads started per call would rebuild every time.
+    class WorkerPool {
+    public:
+        explicit WorkerPool(unsigned threads);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        template<typename F>
+        auto submit(F&& task) -> std::future<decltype(task())> {
+            auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::forward<F>(task));
+            std::future<decltype(task())> result = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace_back([packaged] { (*packaged)(); });
+            }
+            wake.notify_one();
+            return result;
+        }
+
+        // Run task(i) for every i below count on the calling thread and as many workers
+        // as there is work for, and return once all calls have finished, rethrowing the
+        // first exception. On a worker everything runs on the calling thread.
+        template<typename F>
+        void forEach(size_t count, F&& task) {
+            std::atomic<size_t> next(0);
+            auto drain = [&next, &task, count] {
+                for (size_t i; (i = next.fetch_add(1)) < count; ) {
+                    task(i);
+                }
+            };
+            std::vector<std::future<void>> helpers;
+            if (!onWorker()) {
+                for (size_t i = 1; i < count && helpers.size() < workers.size(); i++) {
+                    helpers.push_back(submit(drain));
+                }
+            }
+            std::exception_ptr error;
+            try {
+                drain();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // The helpers reference next and task, so wait for all before leaving
+            for (auto& helper : helpers) {
+                try {
+                    helper.get();
+                } catch (...) {
+                    error = error ? error : std::current_exception();
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+        // True on a worker of any pool. Work running there must not wait on tasks it
+        // submits, since every worker could end up waiting.
+        static bool onWorker();
+
+        // Process-wide pool with one thread per core, started on first use
+        static WorkerPool& shared();
+
+    private:
+        void run();
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> workers;
+        bool stopping;
+    };
 } // namespace internal
 
 } // namespace UQPack
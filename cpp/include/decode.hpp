@@ -1,6 +1,7 @@
 #ifndef DECODE_H
 #define DECODE_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
@@ -12,6 +13,7 @@ using json = nlohmann::json;
 // Forward declare CompressionType from encode.hpp
 namespace UQPack {
     enum class CompressionType;
+    class Dictionary;
 }
 
 /**
@@ -29,14 +31,108 @@ namespace UQPack {
     template<typename T>
     struct always_false : std::false_type {};
 
+    // Decode settings; the defaults match the single-argument decode()
+    struct DecodeOptions {
+        // Threads used to convert very large tokens from their base, and the payload
+        // size from which they are used
+        unsigned threads = 1;
+        size_t parallelThreshold = 256 * 1024;
+    };
+
+    // Outcome of decoding into a caller's buffer
+    struct DecodeResult {
+        CompressionType compressionType{};
+        size_t size = 0;    // decoded bytes, or the capacity needed when they did not fit
+        bool fits = false;  // false: nothing was written
+    };
+
     // Forward declare internal decode function
     std::vector<std::uint8_t> decodeInternal(const std::string& encodedString, CompressionType& outCompressionType);
+    std::vector<std::uint8_t> decodeInternal(const std::string& encodedString, CompressionType& outCompressionType, const DecodeOptions& options);
+
+    // Decode into caller-owned memory; see Decoder::decodeInto
+    DecodeResult decodeInto(const std::string& encodedString, std::uint8_t* output, size_t capacity, const DecodeOptions& options = DecodeOptions());
+    CompressionType decodeInto(const std::string& encodedString, std::vector<std::uint8_t>& buffer, const DecodeOptions& options = DecodeOptions());
+
+    /**
+     * Decoder: reusable decode session.
+     * Holds the decompressor contexts (a ZSTD_DCtx, a libdeflate decompressor and a
+     * memory pool for Brotli's per-call state), so repeated decodes skip allocating
+     * and initializing them.
+     * Not thread-safe: use one Decoder per thread. The free decode() and
+     * decodeInternal() functions run on Decoder::local().
+     */
+    class Decoder {
+    public:
+        Decoder();
+        ~Decoder();
+
+        Decoder(const Decoder&) = delete;
+        Decoder& operator=(const Decoder&) = delete;
+
+        std::vector<std::uint8_t> decodeInternal(const std::string& encodedString, CompressionType& outCompressionType, const DecodeOptions& options = DecodeOptions());
+
+        // Decode into output, which holds capacity bytes. Codecs decompress straight into
+        // it, since tokens record their original size; only streamed ones, which do not,
+        // are decompressed to a temporary first. When the data does not fit, nothing is
+        // written and the result holds the size needed.
+        DecodeResult decodeInto(const std::string& encodedString, std::uint8_t* output, size_t capacity, const DecodeOptions& options = DecodeOptions());
+
+        // Decode into buffer, resized to the decoded size, so a buffer reused across calls
+        // only reallocates when a token decodes to more than its capacity
+        CompressionType decodeInto(const std::string& encodedString, std::vector<std::uint8_t>& buffer, const DecodeOptions& options = DecodeOptions());
+
+        template<typename T>
+        T decode(const std::string& encodedString, const DecodeOptions& options = DecodeOptions());
+
+        // The calling thread's Decoder, created on first use
+        static Decoder& local();
+
+    private:
+        // A token's bytes after the base conversion and what its header says about them
+        struct Payload {
+            CompressionType compressionType{};
+            std::shared_ptr<const Dictionary> dictionary;
+            bool sized = false;  // Brotli payloads carry their original size
+            bool framed = false; // frame of independently compressed blocks
+            std::vector<std::uint8_t> bytes;
+        };
+
+        // Validate the header and checksum and convert the digits
+        Payload parse(const std::string& encodedString, const DecodeOptions& options);
+
+        // Size of the decoded payload as recorded in it, SIZE_MAX if it is not recorded
+        static size_t originalSize(const Payload& payload);
+
+        // Decode payload into output, which holds exactly its original size
+        void decompress(const Payload& payload, std::uint8_t* output, size_t outputSize);
+
+        // Decompress one payload compressed with compressionType (not NONE) into output,
+        // which holds exactly its original size
+        void decompress(CompressionType compressionType, const Dictionary* dictionary, bool sized, const std::uint8_t* data, size_t size,
+                        std::uint8_t* output, size_t outputSize);
+
+        // Same for a payload that does not record its original size
+        std::vector<std::uint8_t> decompress(CompressionType compressionType, const Dictionary* dictionary, const std::uint8_t* data, size_t size);
+
+        // Decompress a frame of independently compressed blocks, in parallel
+        void decompressBlocks(CompressionType compressionType, const Dictionary* dictionary, bool sized, const std::uint8_t* data, size_t size,
+                              std::uint8_t* output, size_t outputSize);
+
+        struct State;
+        std::unique_ptr<State> state;
+    };
 
     // Main decode function template
     template<typename T>
-    inline T decode(const std::string& encodedString) {
+    inline T decode(const std::string& encodedString, const DecodeOptions& options = DecodeOptions()) {
+        return Decoder::local().decode<T>(encodedString, options);
+    }
+
+    template<typename T>
+    inline T Decoder::decode(const std::string& encodedString, const DecodeOptions& options) {
         CompressionType compressionType;
-        auto decodedData = decodeInternal(encodedString, compressionType);
+        auto decodedData = decodeInternal(encodedString, compressionType, options);
         if (decodedData.empty()) {
             throw std::runtime_error("Failed to decode data");
         }
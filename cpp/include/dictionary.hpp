@@ -0,0 +1,172 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Brotli gained custom dictionaries in 1.1.0, the version CMakeLists.txt fetches
+#if __has_include(<brotli/shared_dictionary.h>)
+#define UQPACK_BROTLI_DICTIONARIES 1
+#endif
+
+#ifndef EMSCRIPTEN
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+struct BrotliEncoderPreparedDictionaryStruct;
+union LZ4_stream_u;
+#endif
+
+namespace UQPack {
+    /**
+     * Dictionary: a pre-trained compression dictionary, digested on first use.
+     * Small payloads share most of their structure (keys, currency codes, layout), so
+     * compressing against a dictionary trained on samples of them removes most of what
+     * a codec would otherwise have to spell out in every token. The digested forms (a
+     * zstd CDict/DDict, a prepared Brotli dictionary and a preloaded LZ4 stream) are
+     * built once, immutable and shared by every thread. Brotli uses the content as a raw
+     * shared dictionary, LZ4 as a prefix of which only the last 64 KiB are reachable.
+     */
+    class Dictionary {
+    public:
+        // Tokens carry id in their header; the decoder needs a dictionary with the same id
+        Dictionary(std::uint32_t id, std::vector<std::uint8_t> content);
+
+        // Content owned elsewhere (e.g. a memory-mapped file) and kept alive by owner
+        Dictionary(std::uint32_t id, const std::uint8_t* data, size_t size, std::shared_ptr<const void> owner);
+
+        ~Dictionary();
+
+        Dictionary(const Dictionary&) = delete;
+        Dictionary& operator=(const Dictionary&) = delete;
+
+        // Zstd level the digested compression dictionary is made for
+        static constexpr int zstdLevel = 1;
+
+        std::uint32_t id() const { return dictionaryId; }
+        const std::uint8_t* data() const { return contentData; }
+        size_t size() const { return contentSize; }
+
+        #ifndef EMSCRIPTEN
+        // The first call of any of these digests the content for every codec
+        const ZSTD_CDict_s* zstdCompression() const { digest(); return zstdCDict; }
+        const ZSTD_DDict_s* zstdDecompression() const { digest(); return zstdDDict; }
+
+        // nullptr when built against a Brotli without custom dictionary support
+        const BrotliEncoderPreparedDictionaryStruct* brotliCompression() const { digest(); return brotliPrepared; }
+
+        // Stream preloaded with LZ4_loadDict, for LZ4_attach_dictionary
+        const LZ4_stream_u* lz4Compression() const { digest(); return lz4Stream; }
+        #endif
+
+    private:
+        void digest() const;
+
+        std::uint32_t dictionaryId;
+        std::vector<std::uint8_t> bytes;
+        std::shared_ptr<const void> storage;
+        const std::uint8_t* contentData;
+        size_t contentSize;
+        #ifndef EMSCRIPTEN
+        mutable std::once_flag digested;
+        mutable ZSTD_CDict_s* zstdCDict = nullptr;
+        mutable ZSTD_DDict_s* zstdDDict = nullptr;
+        mutable BrotliEncoderPreparedDictionaryStruct* brotliPrepared = nullptr;
+        mutable LZ4_stream_u* lz4Stream = nullptr;
+        #endif
+    };
+
+    /**
+     * DictionaryRegistry: the dictionaries tokens can be encoded and decoded with.
+     * Several can be loaded at once, so during a rollover tokens made with the old
+     * dictionary still decode while new ones are made with its successor: activate()
+     * the new one and the previous one is retired, staying decodable for the grace
+     * period. The loaded set is an immutable snapshot that writers copy, modify and
+     * publish through an atomic pointer. Lookups take no lock: they count themselves in
+     * while reading the snapshot, and a writer frees the snapshots it replaced once it
+     * sees no lookup in progress. They return a reference-counted handle, so a
+     * dictionary dropped while in use stays alive until the last call using it finishes.
+     */
+    class DictionaryRegistry {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        DictionaryRegistry();
+        ~DictionaryRegistry();
+
+        DictionaryRegistry(const DictionaryRegistry&) = delete;
+        DictionaryRegistry& operator=(const DictionaryRegistry&) = delete;
+
+        // Load content and return its id. Dictionaries trained by zstd (ZDICT_trainFromBuffer,
+        // `zstd --train`, uqpack_train) carry their own id; raw content needs one passed explicitly.
+        // Throws if a dictionary with different content is loaded under the same id: LZ4 and
+        // Brotli tokens do not identify their dictionary beyond the id, so they would decode
+        // to wrong data without an error.
+        std::uint32_t add(const std::vector<std::uint8_t>& content, std::uint32_t id = 0);
+
+        // Same for a dictionary file, which is memory-mapped rather than read, so loading
+        // many of them at startup costs little until they are first used
+        std::uint32_t addFile(const std::string& path, std::uint32_t id = 0);
+
+        // Make id the dictionary new tokens should use and retire the previously active one
+        void activate(std::uint32_t id);
+
+        // Id of the active dictionary, 0 if none
+        std::uint32_t active() const;
+
+        // Keep id decodable for the grace period, then drop it
+        void retire(std::uint32_t id);
+
+        // Drop id immediately
+        void remove(std::uint32_t id);
+
+        // How long retired dictionaries stay loaded (default 24 hours); applies to later retirements
+        void setGracePeriod(Clock::duration gracePeriod);
+
+        // nullptr if no dictionary with this id is loaded
+        std::shared_ptr<const Dictionary> find(std::uint32_t id) const;
+
+        // Throws std::runtime_error if no dictionary with this id is loaded
+        std::shared_ptr<const Dictionary> get(std::uint32_t id) const;
+
+        // The registry consulted by encode() and decode()
+        static DictionaryRegistry& global();
+
+    private:
+        struct Entry {
+            std::shared_ptr<const Dictionary> dictionary;
+            Clock::time_point expires = Clock::time_point::max();
+        };
+
+        struct Snapshot {
+            std::map<std::uint32_t, Entry> entries;
+            std::uint32_t active = 0;
+        };
+
+        // Copy the current snapshot, apply change to the copy and publish it
+        template<typename F>
+        void update(F&& change);
+
+        // Run lookup on the current snapshot, which stays alive until it returns
+        template<typename F>
+        auto read(F&& lookup) const;
+
+        std::uint32_t publish(std::shared_ptr<const Dictionary> dictionary);
+
+        std::mutex writers; // serializes updates; lookups never take it
+        Clock::duration grace;
+        std::atomic<const Snapshot*> current;
+        mutable std::atomic<size_t> readers{0}; // lookups in progress
+
+        // Snapshots replaced while lookups were in progress, freed by a later update or
+        // the destructor; guarded by writers
+        std::vector<std::unique_ptr<const Snapshot>> replaced;
+    };
+}
+
+#endif // DICTIONARY_H
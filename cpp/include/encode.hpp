@@ -1,6 +1,7 @@
 #ifndef ENCODE_H
 #define ENCODE_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -9,12 +10,130 @@
 using json = nlohmann::json;
 
 namespace UQPack {
+    class CompressionTuner;
+
     // Compression types enum for easier selection
     enum class CompressionType {
         NONE = 0,
         LZ4 = 1,
         ZSTD = 2,
-        BROTLI = 3
+        BROTLI = 3,
+        AUTO = 4, // try EncodeOptions::autoCandidates and keep the shortest token
+        LZ4HC = 5, // LZ4's high-compression mode; tokens are plain LZ4 to the decoder
+        DEFLATE = 6 // raw DEFLATE (RFC 1951) via libdeflate, without dictionaries
+    };
+
+    // How the (compressed) bytes are turned into characters of the chosen charset
+    enum class EncodingMode {
+        INTEGER = 0, // Whole payload as one big integer (shortest output)
+        BLOCK = 1    // Fixed 8-byte blocks to fixed digit blocks (linear time, exact length)
+    };
+
+    // Brotli's input hint; payloads are MessagePack, so GENERIC unless they are mostly text
+    enum class BrotliMode {
+        GENERIC = 0,
+        TEXT = 1
+    };
+
+    // Zstd match finders (ZSTD_strategy), slowest and strongest last. DEFAULT lets the
+    // compression level choose.
+    enum class ZstdStrategy {
+        DEFAULT = 0,
+        FAST = 1,
+        DFAST = 2,
+        GREEDY = 3,
+        LAZY = 4,
+        LAZY2 = 5,
+        BTLAZY2 = 6,
+        BTOPT = 7,
+        BTULTRA = 8,
+        BTULTRA2 = 9
+    };
+
+    // Named speed/size trade-offs for EncodeOptions::preset()
+    enum class CompressionPreset {
+        LATENCY,  // hot path: cheapest settings of each codec
+        BALANCED, // moderate levels
+        SMALLEST  // offline exports: strongest settings, large windows
+    };
+
+    // Full set of encode settings; the positional encode() overloads fill in the rest
+    // with these defaults.
+    struct EncodeOptions {
+        CompressionType compressionType = CompressionType::ZSTD;
+        int baseIndex = -1;
+        EncodingMode encodingMode = EncodingMode::INTEGER;
+
+        // Threads used to convert very large payloads to the target base, and the
+        // payload size (after compression) from which they are used
+        unsigned threads = 1;
+        size_t parallelThreshold = 256 * 1024;
+
+        // Tokens are placed in URLs: automatic base selection (baseIndex < 0) counts
+        // characters outside the RFC 3986 unreserved set as three ("%XX")
+        bool urlContext = true;
+
+        // Compress against this dictionary from DictionaryRegistry::global() (0 for none;
+        // not with NONE), typically DictionaryRegistry::global().active(). Its id is
+        // written to the header, so the decoder needs the same dictionary loaded.
+        std::uint32_t dictionaryId = 0;
+
+        // Codec tuning. It only changes how hard the compressor works, never the token
+        // format, so decoders need no matching setting. The defaults are the settings
+        // tokens have always been made with. With a Zstd dictionary the window and
+        // strategy are the dictionary's.
+        int zstdLevel = 1;                                 // 1 to 22, negative for the fast modes
+        int zstdWindowLog = 0;                             // log2 of the window; 0 lets the level choose
+        ZstdStrategy zstdStrategy = ZstdStrategy::DEFAULT;
+        int lz4Acceleration = 1;                           // above 1 trades ratio for speed
+        int lz4hcLevel = 9;                                // LZ4HC: 1 to 12
+        int deflateLevel = 6;                              // libdeflate: 0 to 12
+        int brotliQuality = 11;                            // 0 to 11
+        int brotliWindow = 22;                             // lgwin, 10 to 24
+        BrotliMode brotliMode = BrotliMode::GENERIC;
+
+        // Codecs CompressionType::AUTO tries. NONE is always tried as well, so the
+        // winner's token is never longer than the uncompressed one. DEFLATE is skipped
+        // when dictionaryId is set.
+        std::vector<CompressionType> autoCandidates = {CompressionType::LZ4, CompressionType::ZSTD, CompressionType::BROTLI};
+
+        // Run AUTO's trial compressions concurrently on the shared worker pool
+        bool autoParallel = false;
+
+        // Large payloads: input above this size is split into blocks of this size that
+        // are compressed independently on the shared worker pool and framed, so large
+        // exports, and decoding them, use every core. Costs some ratio since no block
+        // can reference another. 0 (the default) always compresses in one piece.
+        size_t compressionBlockSize = 0;
+
+        // The bytes given to the low-level encode() are such a frame of blocks, as
+        // CodecSelection::framed reports; encode(json) sets it itself
+        bool framedBlocks = false;
+
+        // Let this tuner pick the codec and level of encode(json) from measured
+        // compression times (see tuner.hpp); compressionType and the levels are then
+        // ignored. Not owned, and must outlive every encode using it.
+        CompressionTuner* tuner = nullptr;
+
+        // Default options with the codec tuning of a named preset
+        static EncodeOptions preset(CompressionPreset preset);
+    };
+
+    // Outcome of compressing, for CompressionType::AUTO the codec that won
+    struct CodecSelection {
+        CompressionType compressionType = CompressionType::NONE;
+        size_t originalSize = 0; // bytes before compression (MessagePack for encode(json))
+        size_t compressedSize = 0;
+        size_t length = 0; // encoded digits, counted as in a URL when urlContext is set
+        bool framed = false; // split into blocks (EncodeOptions::compressionBlockSize)
+        int baseIndex = -1;  // charset of the token, as chosen by selectBaseIndex(); set by encode(json)
+    };
+
+    // Outcome of the automatic base selection
+    struct BaseSelection {
+        int baseIndex = 0;
+        size_t length = 0;    // encoded digits
+        size_t urlLength = 0; // encoded digits after percent-encoding
     };
 
     /**
@@ -25,18 +144,85 @@ namespace UQPack {
      * 
      * @param data The binary data to encode
      * @param compressionType Type of compression used (NONE, LZ4, ZSTD)
-     * @param baseIndex The index of the character set to use (0 for Base64, 1 for Base70)
+     * @param baseIndex The index of the character set to use (0 for Base64, 1 for Base70,
+     *                  2 for Base45, which keeps the whole token in the QR alphanumeric set)
+     * @param encodingMode Whether to convert the data as one integer or in fixed-width blocks
      * @return URL-safe encoded string
      */
-    std::string encode(const std::vector<std::uint8_t>& data, CompressionType compressionType = CompressionType::ZSTD, int baseIndex = -1);
+    std::string encode(const std::vector<std::uint8_t>& data, CompressionType compressionType = CompressionType::ZSTD, int baseIndex = -1, EncodingMode encodingMode = EncodingMode::INTEGER);
     
     // Encode JSON data with compression type
-    std::string encode(const json& jsonData, CompressionType compressionType = CompressionType::ZSTD, int baseIndex = -1);
+    std::string encode(const json& jsonData, CompressionType compressionType = CompressionType::ZSTD, int baseIndex = -1, EncodingMode encodingMode = EncodingMode::INTEGER);
+
+    // Encode with explicit options
+    std::string encode(const std::vector<std::uint8_t>& data, const EncodeOptions& options);
+    std::string encode(const json& jsonData, const EncodeOptions& options);
+
+    // Encode JSON and report the codec and charset used, which is how AUTO's winner and
+    // the automatic base selection are exposed
+    std::string encode(const json& jsonData, const EncodeOptions& options, CodecSelection& selection);
+
+    /**
+     * Pick the charset giving the shortest token for data (the bytes after compression)
+     * without converting it. Lengths come from the byte count alone: digit counts of
+     * the integer conversion use logarithms, block and Base45 lengths are linear.
+     * Big-integer conversion to Base70 is only considered up to 64 KiB, above which its
+     * cost outweighs the ~1% it saves over Base64. Ties go to the lower index.
+     */
+    BaseSelection selectBaseIndex(const std::vector<std::uint8_t>& data, const EncodeOptions& options);
+
+    /**
+     * Encoder: reusable encode session.
+     * Holds the compressor contexts (a ZSTD_CCtx, LZ4 and LZ4HC stream states, a
+     * libdeflate compressor, a memory pool for Brotli's per-call state) and an output
+     * scratch buffer, so repeated encodes skip allocating and initializing them.
+     * Not thread-safe: use one Encoder per thread.
+     * The free encode() and compressWith*() functions run on Encoder::local().
+     */
+    class Encoder {
+    public:
+        Encoder();
+        ~Encoder();
+
+        Encoder(const Encoder&) = delete;
+        Encoder& operator=(const Encoder&) = delete;
+
+        std::string encode(const std::vector<std::uint8_t>& data, const EncodeOptions& options = EncodeOptions());
+        std::string encode(const json& jsonData, const EncodeOptions& options = EncodeOptions());
+        std::string encode(const json& jsonData, const EncodeOptions& options, CodecSelection& selection);
+
+        std::vector<std::uint8_t> compress(const std::uint8_t* data, size_t dataSize, CompressionType compressionType, std::uint32_t dictionaryId = 0);
+        std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId = 0);
+        std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId = 0);
+        std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality = 11, std::uint32_t dictionaryId = 0);
+
+        // Compress with options.compressionType, its dictionary and codec tuning
+        std::vector<std::uint8_t> compress(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+
+        // Same, also for AUTO: compresses with every candidate and returns the bytes
+        // whose token would be shortest. Encode them with selection.compressionType
+        // (and no dictionary if that is NONE).
+        std::vector<std::uint8_t> compress(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options, CodecSelection& selection);
+        std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+        std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+        std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+        std::vector<std::uint8_t> compressWithLZ4HC(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+        std::vector<std::uint8_t> compressWithDeflate(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+
+        // The calling thread's Encoder, created on first use
+        static Encoder& local();
+
+    private:
+        std::vector<std::uint8_t> compressBlocks(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options);
+
+        struct State;
+        std::unique_ptr<State> state;
+    };
 
     // Compression functions
-    std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize);
-    std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize);
-    std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality = 11);
+    std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId = 0);
+    std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId = 0);
+    std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality = 11, std::uint32_t dictionaryId = 0);
 }
 
 #endif // ENCODE_H
@@ -0,0 +1,72 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <encode.hpp>
+
+namespace UQPack {
+    // Receive output as soon as it is produced; the pointer is only valid during the call
+    using CharSink = std::function<void(const char* data, size_t size)>;
+    using ByteSink = std::function<void(const std::uint8_t* data, size_t size)>;
+
+    /**
+     * StreamEncoder: push-style encoder for payloads too large to hold in memory.
+     * Input is compressed with a streaming codec, converted in fixed-width blocks
+     * (EncodingMode::BLOCK) and checksummed incrementally, so working memory stays
+     * constant whatever the payload size. The token is handed to the sink in pieces:
+     * the header first, then the digits, then ":" and the checksum from finish().
+     * The concatenated output is an ordinary block-mode token that decode() accepts.
+     *
+     * Supported compression types: NONE, ZSTD, BROTLI. LZ4 needs the whole input
+     * up front and is rejected, as is the Base45 charset (baseIndex 2).
+     */
+    class StreamEncoder {
+    public:
+        StreamEncoder(CharSink sink, CompressionType compressionType = CompressionType::ZSTD, int baseIndex = 0);
+        ~StreamEncoder();
+
+        StreamEncoder(const StreamEncoder&) = delete;
+        StreamEncoder& operator=(const StreamEncoder&) = delete;
+
+        void write(const std::uint8_t* data, size_t size);
+        void write(const std::vector<std::uint8_t>& data) { write(data.data(), data.size()); }
+
+        // Flush the compressor and emit the checksum; the encoder cannot be reused
+        void finish();
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+    };
+
+    /**
+     * StreamDecoder: push-style decoder for block-mode tokens.
+     * The token text may arrive in arbitrary pieces; decoded bytes are handed to the
+     * sink as soon as the blocks carrying them are complete. The checksum can only be
+     * verified by finish(), so callers must discard the output if finish() throws.
+     */
+    class StreamDecoder {
+    public:
+        explicit StreamDecoder(ByteSink sink);
+        ~StreamDecoder();
+
+        StreamDecoder(const StreamDecoder&) = delete;
+        StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+        void write(const char* data, size_t size);
+        void write(const std::string& data) { write(data.data(), data.size()); }
+
+        // Verify the checksum and the end of the compressed stream
+        void finish();
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+    };
+}
+
+#endif // STREAM_H
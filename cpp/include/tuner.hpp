@@ -0,0 +1,109 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <encode.hpp>
+
+namespace UQPack {
+    // One step of the tuner's ladder: a codec and its level (Zstd level, Brotli
+    // quality, LZ4 acceleration, LZ4HC or DEFLATE level; ignored for NONE). NONE and
+    // DEFLATE rungs encode without EncodeOptions::dictionaryId.
+    struct TunerRung {
+        CompressionType compressionType;
+        int level;
+    };
+
+    struct TunerOptions {
+        // Target for the chosen percentile of compression time
+        std::chrono::microseconds latencyBudget{500};
+        double percentile = 0.99;
+
+        // Compression times kept per shape, and how many a rung must collect before the
+        // tuner moves away from it
+        size_t window = 128;
+        size_t minSamples = 32;
+
+        // Hysteresis: move to a stronger rung only while the percentile is below this
+        // fraction of the budget, and stay off a rung that broke the budget for this
+        // many documents of the shape
+        double raiseBelow = 0.5;
+        size_t cooldown = 1000;
+
+        // Ordered from fastest to smallest output, and where new shapes start
+        std::vector<TunerRung> ladder = {
+            {CompressionType::LZ4, 1},
+            {CompressionType::ZSTD, 1},
+            {CompressionType::ZSTD, 3},
+            {CompressionType::BROTLI, 5},
+            {CompressionType::ZSTD, 12},
+            {CompressionType::BROTLI, 9},
+            {CompressionType::BROTLI, 11},
+        };
+        size_t initialRung = 1;
+
+        // Shapes tracked separately; later ones share one entry
+        size_t maxShapes = 1024;
+    };
+
+    /**
+     * CompressionTuner: picks the codec and level per document shape from measured
+     * compression times, so that a latency budget holds under load at the cost of
+     * somewhat longer tokens. A shape is a fingerprint of a document's top-level keys.
+     * Each shape sits on a rung of the ladder and moves to a faster rung when its
+     * percentile time exceeds the budget, or to a stronger one when the time is well
+     * under budget and that rung compresses better. Set EncodeOptions::tuner to use it
+     * in encode(json); one tuner can be shared by all threads.
+     */
+    class CompressionTuner {
+    public:
+        explicit CompressionTuner(TunerOptions options = TunerOptions());
+
+        struct Decision {
+            std::uint64_t shape = 0;
+            size_t rung = 0;
+        };
+
+        // Set options' codec and level for the next document of this shape
+        Decision choose(const json& document, EncodeOptions& options);
+
+        // Report how long compressing a document as decided took and what it produced
+        void record(const Decision& decision, std::chrono::nanoseconds elapsed, size_t inputSize, size_t compressedSize);
+
+        // Per shape: current rung and, per rung used, documents, mean and percentile
+        // compression time (microseconds) and compression ratio
+        json stats() const;
+
+        static std::uint64_t shapeOf(const json& document);
+
+    private:
+        struct RungStats {
+            std::uint64_t documents = 0;
+            double meanMicros = 0;
+            double percentileMicros = 0;
+            double ratio = 0;
+            std::uint64_t blockedUntil = 0;
+        };
+
+        struct Shape {
+            size_t rung = 0;
+            std::uint64_t documents = 0;
+            std::vector<double> recent; // compression times on the current rung, microseconds
+            size_t next = 0;            // ring position in recent
+            size_t samples = 0;         // samples on the current rung since moving to it
+            std::vector<RungStats> rungs;
+        };
+
+        Shape& shape(std::uint64_t fingerprint);
+        void move(Shape& shape, size_t rung);
+
+        TunerOptions options;
+        mutable std::mutex mutex;
+        std::map<std::uint64_t, Shape> shapes;
+    };
+}
+
+#endif // TUNER_H
@@ -11,7 +11,7 @@ int main(int argc, char* argv[])
 {
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0] << " <json_string> [compression_type]" << std::endl;
-        std::cerr << "  compression_type: none, lz4, zlib, zstd (default: lz4)" << std::endl;
+        std::cerr << "  compression_type: none, lz4, lz4hc, zstd, brotli, deflate (default: lz4)" << std::endl;
         return 1;
     }
 
@@ -29,6 +29,11 @@ int main(int argc, char* argv[])
                 compressionType = UQPack::CompressionType::NONE;
             } else if (compressionArg == "lz4") {
                 compressionType = UQPack::CompressionType::LZ4;
+            } else if (compressionArg == "lz4hc") {
+                compressionType = UQPack::CompressionType::LZ4HC;
+            } else if (compressionArg == "deflate" || compressionArg == "zlib") {
+                // "zlib" was listed before DEFLATE existed; tokens carry raw DEFLATE either way
+                compressionType = UQPack::CompressionType::DEFLATE;
             } else if (compressionArg == "zstd") {
                 compressionType = UQPack::CompressionType::ZSTD;
             } else if (compressionArg == "brotli") {
@@ -41,7 +46,16 @@ int main(int argc, char* argv[])
         
         // Encode using our method with specified compression and MessagePack enabled
         // The baseIndex will be automatically selected based on the input
-        std::string urlsafeString = UQPack::encode(j, compressionType);
+        UQPack::EncodeOptions options;
+        options.compressionType = compressionType;
+        UQPack::CodecSelection selection;
+        std::string urlsafeString = UQPack::encode(j, options, selection);
+        if (selection.compressionType != UQPack::CompressionType::NONE) {
+            const char* const codecNames[] = {"None", "LZ4", "Zstd", "Brotli", "Auto", "LZ4HC", "DEFLATE"};
+            std::cout << "Compressed size: " << selection.compressedSize << " bytes (from "
+                      << selection.originalSize << " bytes) using "
+                      << codecNames[static_cast<int>(selection.compressionType)] << std::endl;
+        }
         std::cout << "Encoded string: " << urlsafeString << std::endl;
 
         // // Decode the string here
@@ -0,0 +1,96 @@
+#include <base.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define UQPACK_BASE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace UQPack {
+namespace internal {
+    namespace {
+        // Kernels scan whole vectors and return how many leading bytes they checked, or
+        // SIZE_MAX as soon as they meet an invalid byte.
+        using ScanKernel = size_t (*)(const char* str, size_t size, const DigitTable& table);
+
+        constexpr size_t invalidDigits = SIZE_MAX;
+
+        size_t scanScalar(const char* str, size_t size, const DigitTable& table) {
+            int invalid = 0;
+            for (size_t i = 0; i < size; i++) {
+                invalid |= table[str[i]];
+            }
+            return invalid < 0 ? invalidDigits : size;
+        }
+
+        #ifdef UQPACK_BASE_X86
+        // Bitmap lookup: the low nibble picks a row of lowNibbleRows, the high nibble
+        // picks a bit in it. High nibbles 8-15 map to no bit, so non-ASCII bytes fail.
+        __attribute__((target("sse4.1"))) size_t scanSse41(const char* str, size_t size, const DigitTable& table) {
+            const __m128i rows = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.lowNibbleRows));
+            const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i nibble = _mm_set1_epi8(0x0F);
+
+            size_t done = 0;
+            for (; done + 16 <= size; done += 16) {
+                const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + done));
+                const __m128i row = _mm_shuffle_epi8(rows, _mm_and_si128(in, nibble));
+                const __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+                const __m128i missing = _mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128());
+                if (_mm_movemask_epi8(missing) != 0) {
+                    return invalidDigits;
+                }
+            }
+            return done;
+        }
+
+        __attribute__((target("avx2"))) size_t scanAvx2(const char* str, size_t size, const DigitTable& table) {
+            const __m256i rows = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table.lowNibbleRows)));
+            const __m256i bits = _mm256_setr_epi8(
+                1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+                1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+            size_t done = 0;
+            for (; done + 32 <= size; done += 32) {
+                const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + done));
+                const __m256i row = _mm256_shuffle_epi8(rows, _mm256_and_si256(in, nibble));
+                const __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble));
+                const __m256i missing = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256());
+                if (_mm256_movemask_epi8(missing) != 0) {
+                    return invalidDigits;
+                }
+            }
+            return done;
+        }
+        #endif
+
+        // Pick the widest kernel the running CPU supports, once per process
+        ScanKernel scanKernel() {
+            static const ScanKernel kernel = [] {
+                #ifdef UQPACK_BASE_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2")) {
+                    return scanAvx2;
+                }
+                if (__builtin_cpu_supports("sse4.1")) {
+                    return scanSse41;
+                }
+                #endif
+                return scanScalar;
+            }();
+            return kernel;
+        }
+    }
+
+    bool isValidDigits(const char* str, size_t size, const DigitTable& table) {
+        if (!table.asciiOnly) {
+            return scanScalar(str, size, table) != invalidDigits;
+        }
+        const size_t done = scanKernel()(str, size, table);
+        if (done == invalidDigits) {
+            return false;
+        }
+        return scanScalar(str + done, size - done, table) != invalidDigits;
+    }
+}
+}
@@ -0,0 +1,70 @@
+#include <base45.hpp>
+#include <base.hpp>
+#include <array>
+#include <stdexcept>
+
+namespace UQPack {
+    namespace {
+        // The two low digits of every value below 45^2, so a pair of bytes needs one
+        // division instead of two
+        const std::array<std::array<char, 2>, 45 * 45> base45LowDigits = [] {
+            std::array<std::array<char, 2>, 45 * 45> table;
+            for (unsigned i = 0; i < 45 * 45; i++) {
+                table[i] = {base45Digits[i % 45], base45Digits[i / 45]};
+            }
+            return table;
+        }();
+    }
+
+    std::string convertToBase45(const std::vector<std::uint8_t>& data) {
+        std::string result(base45EncodedLength(data.size()), '\0');
+        const std::uint8_t* in = data.data();
+        char* out = &result[0];
+
+        for (size_t i = 0; i + 1 < data.size(); i += 2, in += 2, out += 3) {
+            const unsigned value = (unsigned(in[0]) << 8) | in[1];
+            const std::array<char, 2>& low = base45LowDigits[value % (45 * 45)];
+            out[0] = low[0];
+            out[1] = low[1];
+            out[2] = base45Digits[value / (45 * 45)];
+        }
+        if (data.size() % 2) {
+            const std::array<char, 2>& low = base45LowDigits[*in];
+            out[0] = low[0];
+            out[1] = low[1];
+        }
+        return result;
+    }
+
+    std::vector<std::uint8_t> convertFromBase45(const std::string& str) {
+        if (str.size() % 3 == 1) {
+            throw std::runtime_error("Invalid Base45 encoded data length");
+        }
+        const internal::DigitTable& table = Base45Alphabet::table;
+        if (!internal::isValidDigits(str.data(), str.size(), table)) {
+            throw std::runtime_error("Invalid character in encoded data");
+        }
+
+        std::vector<std::uint8_t> result(2 * (str.size() / 3) + (str.size() % 3 ? 1 : 0));
+        const char* in = str.data();
+        std::uint8_t* out = result.data();
+
+        // Digits are pre-validated, so only the group value needs a range check
+        unsigned overflow = 0;
+        for (size_t i = 0; i + 2 < str.size(); i += 3, in += 3, out += 2) {
+            const unsigned value = unsigned(table[in[0]]) + 45 * unsigned(table[in[1]]) + 45 * 45 * unsigned(table[in[2]]);
+            overflow |= value >> 16;
+            out[0] = static_cast<std::uint8_t>(value >> 8);
+            out[1] = static_cast<std::uint8_t>(value);
+        }
+        if (str.size() % 3) {
+            const unsigned value = unsigned(table[in[0]]) + 45 * unsigned(table[in[1]]);
+            overflow |= value >> 8;
+            out[0] = static_cast<std::uint8_t>(value);
+        }
+        if (overflow) {
+            throw std::runtime_error("Invalid block in encoded data");
+        }
+        return result;
+    }
+}
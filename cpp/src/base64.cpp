@@ -0,0 +1,302 @@
+#include <base64.hpp>
+#include <base.hpp>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define UQPACK_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace UQPack {
+    namespace {
+        const char* const base64Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+        // ASCII to digit value, -1 for characters outside the alphabet
+        const std::array<std::int8_t, 256> base64Values = [] {
+            std::array<std::int8_t, 256> values;
+            values.fill(-1);
+            for (int i = 0; i < 64; i++) {
+                values[static_cast<unsigned char>(base64Alphabet[i])] = static_cast<std::int8_t>(i);
+            }
+            return values;
+        }();
+
+        // Kernels process whole groups of 3 bytes <-> 4 digits and return the number
+        // of groups they handled; the caller finishes the tail with the scalar kernel.
+        using EncodeKernel = size_t (*)(const std::uint8_t* in, size_t groups, char* out);
+        using DecodeKernel = size_t (*)(const char* in, size_t groups, std::uint8_t* out);
+
+        size_t encodeGroupsScalar(const std::uint8_t* in, size_t groups, char* out) {
+            for (size_t i = 0; i < groups; i++, in += 3, out += 4) {
+                const std::uint32_t word = (std::uint32_t(in[0]) << 16) | (std::uint32_t(in[1]) << 8) | in[2];
+                out[0] = base64Alphabet[(word >> 18) & 0x3F];
+                out[1] = base64Alphabet[(word >> 12) & 0x3F];
+                out[2] = base64Alphabet[(word >> 6) & 0x3F];
+                out[3] = base64Alphabet[word & 0x3F];
+            }
+            return groups;
+        }
+
+        size_t decodeGroupsScalar(const char* in, size_t groups, std::uint8_t* out) {
+            for (size_t i = 0; i < groups; i++, in += 4, out += 3) {
+                const int a = base64Values[static_cast<unsigned char>(in[0])];
+                const int b = base64Values[static_cast<unsigned char>(in[1])];
+                const int c = base64Values[static_cast<unsigned char>(in[2])];
+                const int d = base64Values[static_cast<unsigned char>(in[3])];
+                if ((a | b | c | d) < 0) {
+                    throw std::runtime_error("Invalid character in encoded data");
+                }
+                const std::uint32_t word = (std::uint32_t(a) << 18) | (std::uint32_t(b) << 12) | (std::uint32_t(c) << 6) | std::uint32_t(d);
+                out[0] = static_cast<std::uint8_t>(word >> 16);
+                out[1] = static_cast<std::uint8_t>(word >> 8);
+                out[2] = static_cast<std::uint8_t>(word);
+            }
+            return groups;
+        }
+
+        #ifdef UQPACK_BASE64_X86
+        // SIMD kernels after Mula & Lemire, "Faster Base64 Encoding and Decoding using
+        // AVX2 Instructions", adapted to the URL-safe alphabet. Each 4-byte lane holds
+        // one 3-byte group.
+
+        __attribute__((target("sse4.1"))) inline __m128i splitGroups128(__m128i in) {
+            in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+            const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+            const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+            const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            return _mm_or_si128(t1, t3);
+        }
+
+        __attribute__((target("sse4.1"))) inline __m128i digitsToAscii128(__m128i digits) {
+            const __m128i shiftLut = _mm_setr_epi8(
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+            __m128i index = _mm_subs_epu8(digits, _mm_set1_epi8(51));
+            const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), digits);
+            index = _mm_or_si128(index, _mm_and_si128(upper, _mm_set1_epi8(13)));
+            return _mm_add_epi8(_mm_shuffle_epi8(shiftLut, index), digits);
+        }
+
+        // Returns the digit values and sets valid to all-ones for alphabet characters
+        __attribute__((target("sse4.1"))) inline __m128i asciiToDigits128(__m128i in, __m128i& valid) {
+            const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+            const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+            const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+            const __m128i dash = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+            const __m128i underscore = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+            valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(dash, underscore)));
+
+            __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+            shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+            shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+            shift = _mm_or_si128(shift, _mm_and_si128(dash, _mm_set1_epi8(62 - '-')));
+            shift = _mm_or_si128(shift, _mm_and_si128(underscore, _mm_set1_epi8(63 - '_')));
+            return _mm_add_epi8(in, shift);
+        }
+
+        // Pack 4 x 6-bit digits per lane back into 3 bytes, left in the low 12 bytes
+        __attribute__((target("sse4.1"))) inline __m128i joinGroups128(__m128i digits) {
+            const __m128i pairs = _mm_maddubs_epi16(digits, _mm_set1_epi32(0x01400140));
+            const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+            return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        }
+
+        __attribute__((target("sse4.1"))) size_t encodeGroupsSse41(const std::uint8_t* in, size_t groups, char* out) {
+            // 16-byte loads consume 12 bytes, so stop while a full load is still in bounds
+            size_t done = 0;
+            for (; done + 6 <= groups; done += 4, in += 12, out += 16) {
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), digitsToAscii128(splitGroups128(block)));
+            }
+            return done;
+        }
+
+        __attribute__((target("sse4.1"))) size_t decodeGroupsSse41(const char* in, size_t groups, std::uint8_t* out) {
+            // 16-byte stores write 12 bytes, so stop while a full store is still in bounds
+            size_t done = 0;
+            for (; done + 6 <= groups; done += 4, in += 16, out += 12) {
+                __m128i valid;
+                const __m128i digits = asciiToDigits128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), valid);
+                if (_mm_movemask_epi8(valid) != 0xFFFF) {
+                    throw std::runtime_error("Invalid character in encoded data");
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), joinGroups128(digits));
+            }
+            return done;
+        }
+
+        __attribute__((target("avx2"))) size_t encodeGroupsAvx2(const std::uint8_t* in, size_t groups, char* out) {
+            const __m256i split = _mm256_setr_epi8(
+                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+            const __m256i shiftLut = _mm256_setr_epi8(
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0,
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+
+            // Two 16-byte loads at +0 and +12 consume 24 bytes and read 28
+            size_t done = 0;
+            for (; done + 10 <= groups; done += 8, in += 24, out += 32) {
+                __m256i block = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+                block = _mm256_shuffle_epi8(block, split);
+                const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0FC0FC00));
+                const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+                const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003F03F0));
+                const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+                const __m256i digits = _mm256_or_si256(t1, t3);
+
+                __m256i index = _mm256_subs_epu8(digits, _mm256_set1_epi8(51));
+                const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), digits);
+                index = _mm256_or_si256(index, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+                const __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, index), digits);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), ascii);
+            }
+            return done;
+        }
+
+        __attribute__((target("avx2"))) size_t decodeGroupsAvx2(const char* in, size_t groups, std::uint8_t* out) {
+            const __m256i join = _mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+            // 32-byte stores write 24 bytes, so stop while a full store is still in bounds
+            size_t done = 0;
+            for (; done + 11 <= groups; done += 8, in += 32, out += 24) {
+                const __m256i ascii = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+                const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(ascii, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), ascii));
+                const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(ascii, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), ascii));
+                const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(ascii, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), ascii));
+                const __m256i dash = _mm256_cmpeq_epi8(ascii, _mm256_set1_epi8('-'));
+                const __m256i underscore = _mm256_cmpeq_epi8(ascii, _mm256_set1_epi8('_'));
+                const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(dash, underscore)));
+                if (_mm256_movemask_epi8(valid) != -1) {
+                    throw std::runtime_error("Invalid character in encoded data");
+                }
+
+                __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+                shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+                shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+                shift = _mm256_or_si256(shift, _mm256_and_si256(dash, _mm256_set1_epi8(62 - '-')));
+                shift = _mm256_or_si256(shift, _mm256_and_si256(underscore, _mm256_set1_epi8(63 - '_')));
+                const __m256i digits = _mm256_add_epi8(ascii, shift);
+
+                const __m256i pairs = _mm256_maddubs_epi16(digits, _mm256_set1_epi32(0x01400140));
+                const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+                const __m256i packed = _mm256_permutevar8x32_epi32(
+                    _mm256_shuffle_epi8(words, join), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+            }
+            return done;
+        }
+        #endif
+
+        // Pick the widest kernels the running CPU supports, once per process
+        struct Base64Kernels {
+            EncodeKernel encode;
+            DecodeKernel decode;
+        };
+
+        const Base64Kernels& base64Kernels() {
+            static const Base64Kernels kernels = [] {
+                #ifdef UQPACK_BASE64_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2")) {
+                    return Base64Kernels{encodeGroupsAvx2, decodeGroupsAvx2};
+                }
+                if (__builtin_cpu_supports("sse4.1")) {
+                    return Base64Kernels{encodeGroupsSse41, decodeGroupsSse41};
+                }
+                #endif
+                return Base64Kernels{encodeGroupsScalar, decodeGroupsScalar};
+            }();
+            return kernels;
+        }
+    }
+
+    std::string convertToBase64Url(const std::vector<std::uint8_t>& data) {
+        // Skip leading zero bytes; they contribute no digits to the integer value
+        size_t start = 0;
+        while (start < data.size() && data[start] == 0) {
+            start++;
+        }
+        if (start == data.size()) {
+            return std::string(1, base64Alphabet[0]);
+        }
+
+        // Digits are aligned to the least significant end, so the (size % 3) leading
+        // bytes form a short head group and the rest splits into 3-byte groups.
+        const std::uint8_t* in = data.data() + start;
+        const size_t size = data.size() - start;
+        const size_t headBytes = size % 3;
+        const size_t groups = size / 3;
+
+        std::string result(headBytes + 1 + groups * 4, base64Alphabet[0]);
+        char* out = &result[0];
+        if (headBytes == 1) {
+            out[0] = base64Alphabet[in[0] >> 6];
+            out[1] = base64Alphabet[in[0] & 0x3F];
+            out += 2;
+        } else if (headBytes == 2) {
+            const std::uint32_t word = (std::uint32_t(in[0]) << 8) | in[1];
+            out[0] = base64Alphabet[word >> 12];
+            out[1] = base64Alphabet[(word >> 6) & 0x3F];
+            out[2] = base64Alphabet[word & 0x3F];
+            out += 3;
+        } else {
+            // No head group; drop the unused slot reserved for it
+            result.pop_back();
+        }
+        in += headBytes;
+
+        const size_t done = base64Kernels().encode(in, groups, out);
+        encodeGroupsScalar(in + done * 3, groups - done, out + done * 4);
+
+        // The leading byte is non-zero, so at most the first digit can be zero
+        if (result[0] == base64Alphabet[0]) {
+            result.erase(0, 1);
+        }
+        return result;
+    }
+
+    std::vector<std::uint8_t> convertFromBase64Url(const std::string& str) {
+        const size_t headDigits = str.size() % 4;
+        const size_t groups = str.size() / 4;
+
+        // A head of h digits carries 6h bits, which needs h bytes (h <= 3)
+        std::vector<std::uint8_t> result(headDigits + groups * 3);
+        std::uint32_t head = 0;
+        for (size_t i = 0; i < headDigits; i++) {
+            const int value = base64Values[static_cast<unsigned char>(str[i])];
+            if (value < 0) {
+                throw std::runtime_error("Invalid character in encoded data");
+            }
+            head = (head << 6) | static_cast<std::uint32_t>(value);
+        }
+        for (size_t i = 0; i < headDigits; i++) {
+            result[i] = static_cast<std::uint8_t>(head >> (8 * (headDigits - 1 - i)));
+        }
+
+        const char* in = str.data() + headDigits;
+        std::uint8_t* out = result.data() + headDigits;
+        const size_t done = base64Kernels().decode(in, groups, out);
+        decodeGroupsScalar(in + done * 4, groups - done, out + done * 3);
+
+        // Match convertFromBase: minimal big-endian bytes, a single zero for zero
+        size_t start = 0;
+        while (start + 1 < result.size() && result[start] == 0) {
+            start++;
+        }
+        if (result.empty()) {
+            result.push_back(0);
+        } else if (start > 0) {
+            result.erase(result.begin(), result.begin() + start);
+        }
+        return result;
+    }
+}
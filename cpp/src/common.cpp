@@ -1,6 +1,10 @@
 #include <common.hpp>
 #include <base.hpp>
 #include <siphash.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 
 namespace UQPack {
 
@@ -10,6 +14,58 @@ std::string calculateChecksum(const std::string& input) {
     return internal::convertToBase64(hashValue).substr(0, 2);
 }
 
+std::string calculateQrChecksum(const std::string& input) {
+    internal::SipHashKey sipKey;
+    uint64_t hashValue = internal::siphash24(input.data(), input.size(), &sipKey) % (36 * 36);
+    return {base45Digits[hashValue / 36], base45Digits[hashValue % 36]};
+}
+
+ChecksumStream::ChecksumStream() : totalSize(0), pending(), pendingSize(0) {
+    internal::SipHashKey sipKey;
+    v0 = sipKey.k0 ^ 0x736f6d6570736575ULL;
+    v1 = sipKey.k1 ^ 0x646f72616e646f6dULL;
+    v2 = sipKey.k0 ^ 0x6c7967656e657261ULL;
+    v3 = sipKey.k1 ^ 0x7465646279746573ULL;
+}
+
+void ChecksumStream::update(const char* data, size_t size) {
+    totalSize += size;
+    while (size > 0) {
+        size_t take = std::min(size, sizeof(pending) - pendingSize);
+        std::memcpy(pending + pendingSize, data, take);
+        pendingSize += take;
+        data += take;
+        size -= take;
+
+        // Same per-word compression as siphash::siphash24
+        if (pendingSize == sizeof(pending)) {
+            uint64_t word;
+            std::memcpy(&word, pending, sizeof(word));
+            word = _le64toh(word);
+            v3 ^= word;
+            siphash::sip_double_round(v0, v1, v2, v3);
+            v0 ^= word;
+            pendingSize = 0;
+        }
+    }
+}
+
+std::string ChecksumStream::finish() const {
+    uint64_t a = v0, b = v1, c = v2, d = v3;
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, pending, pendingSize);
+    uint64_t last = (totalSize << 56) | _le64toh(tail);
+
+    d ^= last;
+    siphash::sip_double_round(a, b, c, d);
+    a ^= last;
+    c ^= 0xff;
+    siphash::sip_double_round(a, b, c, d);
+    siphash::sip_double_round(a, b, c, d);
+    return internal::convertToBase64((a ^ b) ^ (c ^ d)).substr(0, 2);
+}
+
 namespace internal {
 
 uint64_t siphash24(const void* data, size_t size, const SipHashKey* key) {
@@ -22,5 +78,98 @@ std::string convertToBase64(uint64_t value) {
     return UQPack::convertToBase64(value);
 }
 
+namespace {
+    // Every block starts with its size, padded to keep the payload max-aligned
+    constexpr size_t blockHeader = alignof(std::max_align_t);
+}
+
+BlockPool::~BlockPool() {
+    for (auto& entry : freeBlocks) {
+        for (void* block : entry.second) {
+            std::free(block);
+        }
+    }
+}
+
+void* BlockPool::allocate(void* opaque, size_t size) {
+    BlockPool* pool = static_cast<BlockPool*>(opaque);
+    auto it = pool->freeBlocks.find(size);
+    if (it != pool->freeBlocks.end() && !it->second.empty()) {
+        void* block = it->second.back();
+        it->second.pop_back();
+        pool->cachedBytes -= size;
+        return static_cast<char*>(block) + blockHeader;
+    }
+
+    void* block = std::malloc(blockHeader + size);
+    if (!block) {
+        return nullptr;
+    }
+    *static_cast<size_t*>(block) = size;
+    return static_cast<char*>(block) + blockHeader;
+}
+
+void BlockPool::release(void* opaque, void* address) {
+    if (!address) {
+        return;
+    }
+    BlockPool* pool = static_cast<BlockPool*>(opaque);
+    void* block = static_cast<char*>(address) - blockHeader;
+    const size_t size = *static_cast<size_t*>(block);
+    if (pool->cachedBytes + size > maxCachedBytes) {
+        std::free(block);
+        return;
+    }
+    pool->freeBlocks[size].push_back(block);
+    pool->cachedBytes += size;
+}
+
+namespace {
+    thread_local bool isWorker = false;
+}
+
+WorkerPool::WorkerPool(unsigned threads) : stopping(false) {
+    for (unsigned i = 0; i < std::max(1u, threads); i++) {
+        workers.emplace_back([this] { run(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run() {
+    isWorker = true;
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool WorkerPool::onWorker() {
+    return isWorker;
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
 } // namespace internal
 } // namespace UQPack
@@ -1,14 +1,19 @@
 #include <decode.hpp>
 #include <encode.hpp>
 #include <base.hpp>
+#include <base45.hpp>
+#include <base64.hpp>
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <siphash.hpp>
 #include <brotli/decode.h>
+#include <libdeflate.h>
 #include <common.hpp>
+#include <dictionary.hpp>
 
 #ifndef EMSCRIPTEN
 #include <lz4.h>
@@ -19,67 +24,178 @@
 // This function reverses the encoding process performed by UQEncode.
 namespace UQPack {
     #ifndef EMSCRIPTEN
-    // Helper function to decompress data using LZ4
-    std::vector<std::uint8_t> decompressWithLZ4(const std::uint8_t* compressedData, size_t compressedSize, size_t originalSize) {
-        std::vector<std::uint8_t> decompressBuffer(originalSize);
-        
-        int decompressedSize = LZ4_decompress_safe(
-            reinterpret_cast<const char*>(compressedData),
-            reinterpret_cast<char*>(decompressBuffer.data()),
-            compressedSize,
-            originalSize
-        );
+    // Helper function to decompress data using LZ4 straight into output, which holds
+    // exactly the original size. dictionary is the prefix the block was compressed with,
+    // or nullptr.
+    void decompressWithLZ4(const Dictionary* dictionary, const std::uint8_t* compressedData, size_t compressedSize, std::uint8_t* output, size_t originalSize) {
+        int decompressedSize;
+        if (dictionary) {
+            decompressedSize = LZ4_decompress_safe_usingDict(
+                reinterpret_cast<const char*>(compressedData),
+                reinterpret_cast<char*>(output),
+                compressedSize,
+                originalSize,
+                reinterpret_cast<const char*>(dictionary->data()),
+                static_cast<int>(dictionary->size())
+            );
+        } else {
+            decompressedSize = LZ4_decompress_safe(
+                reinterpret_cast<const char*>(compressedData),
+                reinterpret_cast<char*>(output),
+                compressedSize,
+                originalSize
+            );
+        }
         
-        if (decompressedSize < 0) {
+        if (decompressedSize < 0 || static_cast<size_t>(decompressedSize) != originalSize) {
             throw std::runtime_error("LZ4 decompression failed");
         }
-        
-        // Return only the decompressed portion
-        return std::vector<std::uint8_t>(decompressBuffer.begin(), decompressBuffer.begin() + decompressedSize);
     }
 
-    // Helper function to decompress data using zstd
-    std::vector<std::uint8_t> decompressWithZstd(const std::uint8_t* compressedData, size_t compressedSize) {
-        // Retrieve the stored decompressed size from the frame header
+    // Original size stored in a zstd frame header; ZSTD_CONTENTSIZE_UNKNOWN for frames
+    // written by StreamEncoder
+    unsigned long long zstdContentSize(const std::uint8_t* compressedData, size_t compressedSize) {
         unsigned long long storedSize = ZSTD_getFrameContentSize(compressedData, compressedSize);
         if (storedSize == ZSTD_CONTENTSIZE_ERROR) {
             throw std::runtime_error("Error reading stored decompressed size from compressed data");
         }
-        if (storedSize == ZSTD_CONTENTSIZE_UNKNOWN) {
-            throw std::runtime_error("Decompressed size unknown in compressed data frame");
-        }
+        return storedSize;
+    }
 
-        // Prepare the buffer for decompression
-        std::vector<std::uint8_t> decompressBuffer(storedSize);
+    // Helper function to decompress a zstd frame of known size straight into output,
+    // reusing the session's context. ddict is the digested dictionary the frame was
+    // compressed with, or nullptr.
+    void decompressWithZstd(ZSTD_DCtx* dctx, const ZSTD_DDict* ddict, const std::uint8_t* compressedData, size_t compressedSize,
+                            std::uint8_t* output, size_t originalSize) {
+        // Drop any dictionary a previous streamed frame left referenced
+        ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
 
-        size_t decompressedSize = ZSTD_decompress(
-            decompressBuffer.data(),
-            storedSize,
-            reinterpret_cast<const char*>(compressedData),
-            compressedSize
-        );
+        size_t decompressedSize = ddict
+            ? ZSTD_decompress_usingDDict(dctx, output, originalSize, compressedData, compressedSize, ddict)
+            : ZSTD_decompressDCtx(dctx, output, originalSize, compressedData, compressedSize);
 
         if (ZSTD_isError(decompressedSize)) {
             throw std::runtime_error("Zstd decompression failed: " +
                                     std::string(ZSTD_getErrorName(decompressedSize)));
         }
+        if (decompressedSize != originalSize) {
+            throw std::runtime_error("Mismatch between stored and actual decompressed size");
+        }
+    }
 
-        // Return only the decompressed portion
-        return std::vector<std::uint8_t>(decompressBuffer.begin(),
-                                        decompressBuffer.begin() + decompressedSize);
+    // Same for a frame without a stored size, decompressed in pieces
+    std::vector<std::uint8_t> decompressWithZstd(ZSTD_DCtx* dctx, const ZSTD_DDict* ddict, const std::uint8_t* compressedData, size_t compressedSize) {
+        ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+        if (ddict) {
+            ZSTD_DCtx_refDDict(dctx, ddict);
+        }
+        std::vector<std::uint8_t> output;
+        std::vector<std::uint8_t> chunk(ZSTD_DStreamOutSize());
+        ZSTD_inBuffer input = {compressedData, compressedSize, 0};
+        size_t result = 1;
+        while (input.pos < input.size && result != 0) {
+            ZSTD_outBuffer out = {chunk.data(), chunk.size(), 0};
+            result = ZSTD_decompressStream(dctx, &out, &input);
+            if (ZSTD_isError(result)) {
+                throw std::runtime_error("Zstd decompression failed: " +
+                                        std::string(ZSTD_getErrorName(result)));
+            }
+            output.insert(output.end(), chunk.begin(), chunk.begin() + out.pos);
+        }
+        if (result != 0) {
+            throw std::runtime_error("Zstd decompression failed: truncated frame");
+        }
+        return output;
     }
     #endif
 
-    // Helper function to decompress data using Brotli
-    std::vector<std::uint8_t> decompressWithBrotli(const std::uint8_t* compressedData, size_t compressedSize) {
-        // Create a decoder state
-        BrotliDecoderState* state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
-        if (!state) {
-            throw std::runtime_error("Failed to create Brotli decoder instance");
+    namespace {
+        // Brotli streams without a size prefix (streamed tokens and ones made before the
+        // prefix) are decompressed into a growing buffer that stops at this size
+        constexpr size_t unsizedBrotliLimit = 256 * 1024 * 1024;
+
+        // A size prefix claiming more than this many output bytes per input byte is
+        // rejected before allocating; Brotli's densest output (long runs of one byte)
+        // stays below 2^20
+        constexpr std::uint64_t maxBrotliRatio = 1 << 24;
+
+        // DEFLATE cannot exceed about 1032:1 (258-byte matches in a few bits each)
+        constexpr std::uint64_t maxDeflateRatio = 1032;
+
+        // LZ4 spends a byte per 255 bytes of match length; Zstd's densest block is an
+        // RLE block, 128 KiB from 4 bytes
+        constexpr std::uint64_t maxLZ4Ratio = 256;
+        constexpr std::uint64_t maxZstdRatio = 1 << 16;
+
+        // Whether size compressed bytes of this codec can hold originalSize bytes, so that
+        // sizes a payload claims are checked before anything is allocated for them
+        bool plausibleSize(CompressionType compressionType, std::uint64_t originalSize, size_t size) {
+            std::uint64_t ratio = 1;
+            switch (compressionType) {
+                case CompressionType::LZ4:
+                    ratio = maxLZ4Ratio;
+                    break;
+                case CompressionType::ZSTD:
+                    ratio = maxZstdRatio;
+                    break;
+                case CompressionType::BROTLI:
+                    ratio = maxBrotliRatio;
+                    break;
+                case CompressionType::DEFLATE:
+                    ratio = maxDeflateRatio;
+                    break;
+                default:
+                    break;
+            }
+            return originalSize <= size * ratio + 1024;
         }
 
+        // Decoder states cannot be reset, so each call builds one on the session's pooled
+        // memory. The decoder only references the dictionary's content, which outlives it.
+        BrotliDecoderState* createBrotliDecoder(internal::BlockPool& pool, const Dictionary* dictionary) {
+            BrotliDecoderState* state = BrotliDecoderCreateInstance(internal::BlockPool::allocate, internal::BlockPool::release, &pool);
+            if (!state) {
+                throw std::runtime_error("Failed to create Brotli decoder instance");
+            }
+            if (dictionary) {
+                #ifdef UQPACK_BROTLI_DICTIONARIES
+                if (!BrotliDecoderAttachDictionary(state, BROTLI_SHARED_DICTIONARY_RAW, dictionary->size(), dictionary->data())) {
+                    BrotliDecoderDestroyInstance(state);
+                    throw std::runtime_error("Failed to attach Brotli dictionary");
+                }
+                #else
+                BrotliDecoderDestroyInstance(state);
+                throw std::runtime_error("Brotli dictionaries need Brotli 1.1.0 or later");
+                #endif
+            }
+            return state;
+        }
+    }
+
+    // Helper function to decompress a Brotli stream of known original size in one pass,
+    // straight into output. dictionary is the one the stream was compressed with, or nullptr.
+    void decompressWithBrotli(internal::BlockPool& pool, const Dictionary* dictionary, const std::uint8_t* compressedData, size_t compressedSize,
+                              std::uint8_t* output, size_t outputSize) {
+        BrotliDecoderState* state = createBrotliDecoder(pool, dictionary);
+        size_t availableIn = compressedSize;
+        const uint8_t* nextIn = compressedData;
+        size_t availableOut = outputSize;
+        uint8_t* nextOut = output;
+        BrotliDecoderResult result = BrotliDecoderDecompressStream(state, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+        BrotliDecoderDestroyInstance(state);
+
+        if (result != BROTLI_DECODER_RESULT_SUCCESS || availableOut != 0) {
+            throw std::runtime_error("Brotli decompression failed");
+        }
+    }
+
+    // Same for a stream of unknown original size, decompressed into a buffer that grows
+    // up to unsizedBrotliLimit
+    std::vector<std::uint8_t> decompressWithBrotli(internal::BlockPool& pool, const Dictionary* dictionary, const std::uint8_t* compressedData, size_t compressedSize) {
+        BrotliDecoderState* state = createBrotliDecoder(pool, dictionary);
+
         // Start with a reasonable buffer size
-        size_t bufferSize = compressedSize * 4;  // Assume up to 4:1 compression ratio
+        size_t bufferSize = std::min(std::max<size_t>(compressedSize * 4, 1024), unsizedBrotliLimit);  // Assume up to 4:1 compression ratio
         std::vector<std::uint8_t> decompressBuffer(bufferSize);
         size_t availableIn = compressedSize;
         const uint8_t* nextIn = compressedData;
@@ -100,14 +216,20 @@ namespace UQPack {
             if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
                 // Buffer is too small, resize it
                 size_t currentSize = decompressBuffer.size();
-                decompressBuffer.resize(currentSize * 2);
-                availableOut = currentSize;
+                if (currentSize >= unsizedBrotliLimit) {
+                    break;
+                }
+                decompressBuffer.resize(std::min(currentSize * 2, unsizedBrotliLimit));
+                availableOut = decompressBuffer.size() - currentSize;
                 nextOut = decompressBuffer.data() + totalOut;
             }
         } while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
 
         BrotliDecoderDestroyInstance(state);
 
+        if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+            throw std::runtime_error("Brotli decompression failed: output exceeds " + std::to_string(unsizedBrotliLimit) + " bytes");
+        }
         if (result != BROTLI_DECODER_RESULT_SUCCESS) {
             throw std::runtime_error("Brotli decompression failed");
         }
@@ -117,7 +239,343 @@ namespace UQPack {
         return decompressBuffer;
     }
 
+    // Long-lived codec state; see Decoder in decode.hpp
+    struct Decoder::State {
+        #ifndef EMSCRIPTEN
+        ZSTD_DCtx* zstd = nullptr;
+        #endif
+        internal::BlockPool brotliPool;
+        libdeflate_decompressor* deflate = nullptr;
+
+        State() {
+            #ifndef EMSCRIPTEN
+            zstd = ZSTD_createDCtx();
+            if (!zstd) {
+                throw std::runtime_error("Failed to create Zstd decompression context");
+            }
+            #endif
+            deflate = libdeflate_alloc_decompressor();
+            if (!deflate) {
+                #ifndef EMSCRIPTEN
+                ZSTD_freeDCtx(zstd);
+                #endif
+                throw std::runtime_error("Failed to create DEFLATE decompressor");
+            }
+        }
+
+        ~State() {
+            #ifndef EMSCRIPTEN
+            ZSTD_freeDCtx(zstd);
+            #endif
+            libdeflate_free_decompressor(deflate);
+        }
+    };
+
+    Decoder::Decoder() : state(new State()) {}
+
+    Decoder::~Decoder() = default;
+
+    Decoder& Decoder::local() {
+        thread_local Decoder decoder;
+        return decoder;
+    }
+
+    namespace {
+        // Original sizes that only decompressing tells
+        constexpr size_t unknownSize = SIZE_MAX;
+
+        // Frame written by Encoder::compressBlocks: block size, original size and the
+        // offsets of the blocks in the frame (count + 1 of them)
+        struct BlockFrame {
+            size_t blockSize;
+            size_t originalSize;
+            std::vector<size_t> offsets;
+        };
+
+        // Move data into buffer, copying instead when buffer's storage is large enough, so
+        // that a buffer reused across calls keeps its capacity
+        void keepInto(std::vector<std::uint8_t>& buffer, std::vector<std::uint8_t>& data) {
+            if (buffer.capacity() < data.size()) {
+                buffer.swap(data);
+            } else {
+                buffer.assign(data.begin(), data.end());
+            }
+        }
+
+        // Original size a compressed payload records, or unknownSize
+        size_t recordedSize(CompressionType compressionType, bool sized, const std::uint8_t* data, size_t size) {
+            switch (compressionType) {
+                case CompressionType::LZ4:
+                    // The first 4 bytes are the original size. This is necessary for lz4 which does not support dynamically allocating memory during decompression
+                    if (size < 4) {
+                        throw std::runtime_error("Invalid compressed data: too short");
+                    }
+                    // Blocks of a frame need not be aligned
+                    if (!plausibleSize(compressionType, internal::loadSize32(data), size)) {
+                        throw std::runtime_error("Invalid LZ4 size prefix");
+                    }
+                    return internal::loadSize32(data);
+                case CompressionType::ZSTD: {
+                    #ifndef EMSCRIPTEN
+                    unsigned long long storedSize = zstdContentSize(data, size);
+                    if (storedSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+                        return unknownSize;
+                    }
+                    if (!plausibleSize(compressionType, storedSize, size)) {
+                        throw std::runtime_error("Invalid Zstd frame: content size too large");
+                    }
+                    return static_cast<size_t>(storedSize);
+                    #else
+                    throw std::runtime_error("Zstd compression not supported on this platform");
+                    #endif
+                }
+                case CompressionType::BROTLI: {
+                    if (!sized) {
+                        return unknownSize;
+                    }
+                    size_t pos = 0;
+                    std::uint64_t originalSize;
+                    if (!internal::readVarint(data, size, pos, originalSize) || !plausibleSize(compressionType, originalSize, size)) {
+                        throw std::runtime_error("Invalid Brotli size prefix");
+                    }
+                    return static_cast<size_t>(originalSize);
+                }
+                case CompressionType::DEFLATE: {
+                    size_t pos = 0;
+                    std::uint64_t originalSize;
+                    if (!internal::readVarint(data, size, pos, originalSize) || !plausibleSize(compressionType, originalSize, size)) {
+                        throw std::runtime_error("Invalid DEFLATE size prefix");
+                    }
+                    return static_cast<size_t>(originalSize);
+                }
+                default:
+                    return size;
+            }
+        }
+
+        // Checks the whole frame before its original size is used: the block table has to
+        // cover the frame exactly, and every block has to record (or, if it records none,
+        // be able to hold) its share of the original size
+        BlockFrame parseBlockFrame(CompressionType compressionType, bool sized, const std::uint8_t* data, size_t size) {
+            if (size < 9 || data[0] != 1) {
+                throw std::runtime_error("Invalid block frame header");
+            }
+            BlockFrame frame;
+            frame.blockSize = internal::loadSize32(data + 1);
+            frame.originalSize = internal::loadSize32(data + 5);
+            if (frame.blockSize == 0) {
+                throw std::runtime_error("Invalid block frame: zero block size");
+            }
+            const size_t count = (frame.originalSize + frame.blockSize - 1) / frame.blockSize;
+            if ((size - 9) / 4 < count) {
+                throw std::runtime_error("Invalid block frame: truncated block table");
+            }
+            frame.offsets.assign(count + 1, 9 + 4 * count);
+            size_t total = 0;
+            for (size_t i = 0; i < count; i++) {
+                const size_t blockBytes = internal::loadSize32(data + 9 + 4 * i);
+                if (blockBytes > size - frame.offsets[i]) {
+                    throw std::runtime_error("Invalid block frame: truncated block");
+                }
+                frame.offsets[i + 1] = frame.offsets[i] + blockBytes;
+
+                const size_t expected = std::min(frame.blockSize, frame.originalSize - i * frame.blockSize);
+                const size_t recorded = recordedSize(compressionType, sized, data + frame.offsets[i], blockBytes);
+                if (recorded == unknownSize ? !plausibleSize(compressionType, expected, blockBytes) : recorded != expected) {
+                    throw std::runtime_error("Invalid block frame: block " + std::to_string(i) + " has the wrong size");
+                }
+                total += expected;
+            }
+            if (frame.offsets[count] != size) {
+                throw std::runtime_error("Invalid block frame: block table does not match the frame size");
+            }
+            if (total != frame.originalSize) {
+                throw std::runtime_error("Invalid block frame: wrong original size");
+            }
+            return frame;
+        }
+    }
+
+    void Decoder::decompress(CompressionType compressionType, const Dictionary* dictionary, bool sized, const std::uint8_t* data, size_t size,
+                             std::uint8_t* output, size_t outputSize) {
+        switch (compressionType) {
+            case CompressionType::LZ4:
+                #ifndef EMSCRIPTEN
+                decompressWithLZ4(dictionary, data + 4, size - 4, output, outputSize);
+                return;
+                #else
+                throw std::runtime_error("LZ4 compression not supported on this platform");
+                #endif
+            case CompressionType::ZSTD:
+                #ifndef EMSCRIPTEN
+                if (zstdContentSize(data, size) != ZSTD_CONTENTSIZE_UNKNOWN) {
+                    decompressWithZstd(state->zstd, dictionary ? dictionary->zstdDecompression() : nullptr, data, size, output, outputSize);
+                    return;
+                }
+                break;
+                #else
+                throw std::runtime_error("Zstd compression not supported on this platform");
+                #endif
+            case CompressionType::BROTLI:
+                if (sized) {
+                    // Skip the size prefix recordedSize() has checked
+                    size_t pos = 0;
+                    std::uint64_t prefixed;
+                    internal::readVarint(data, size, pos, prefixed);
+                    decompressWithBrotli(state->brotliPool, dictionary, data + pos, size - pos, output, outputSize);
+                    return;
+                }
+                break;
+            case CompressionType::DEFLATE: {
+                // Skip the size prefix recordedSize() has checked
+                size_t pos = 0;
+                std::uint64_t prefixed;
+                internal::readVarint(data, size, pos, prefixed);
+                // Without an actual size to report, libdeflate requires the output to be filled exactly
+                if (libdeflate_deflate_decompress(state->deflate, data + pos, size - pos, output, outputSize, nullptr) != LIBDEFLATE_SUCCESS) {
+                    throw std::runtime_error("DEFLATE decompression failed");
+                }
+                return;
+            }
+            default:
+                throw std::runtime_error("Unsupported compression type");
+        }
+
+        // Streams that do not record their size
+        std::vector<std::uint8_t> decompressed = decompress(compressionType, dictionary, data, size);
+        if (decompressed.size() != outputSize) {
+            throw std::runtime_error("Decompressed size does not match the recorded size");
+        }
+        std::copy(decompressed.begin(), decompressed.end(), output);
+    }
+
+    std::vector<std::uint8_t> Decoder::decompress(CompressionType compressionType, const Dictionary* dictionary, const std::uint8_t* data, size_t size) {
+        switch (compressionType) {
+            case CompressionType::ZSTD:
+                #ifndef EMSCRIPTEN
+                return decompressWithZstd(state->zstd, dictionary ? dictionary->zstdDecompression() : nullptr, data, size);
+                #else
+                throw std::runtime_error("Zstd compression not supported on this platform");
+                #endif
+            case CompressionType::BROTLI:
+                return decompressWithBrotli(state->brotliPool, dictionary, data, size);
+            default:
+                throw std::runtime_error("Unsupported compression type");
+        }
+    }
+
+    void Decoder::decompressBlocks(CompressionType compressionType, const Dictionary* dictionary, bool sized, const std::uint8_t* data, size_t size,
+                                   std::uint8_t* output, size_t outputSize) {
+        const BlockFrame frame = parseBlockFrame(compressionType, sized, data, size);
+        if (frame.originalSize != outputSize) {
+            throw std::runtime_error("Invalid block frame: wrong original size");
+        }
+        const size_t count = frame.offsets.size() - 1;
+        auto decompressBlock = [&](size_t i) {
+            // Workers decompress with their own sessions, each block into its place
+            Decoder& decoder = internal::WorkerPool::onWorker() ? Decoder::local() : *this;
+            const std::uint8_t* block = data + frame.offsets[i];
+            const size_t blockBytes = frame.offsets[i + 1] - frame.offsets[i];
+            const size_t expected = std::min(frame.blockSize, frame.originalSize - i * frame.blockSize);
+            decoder.decompress(compressionType, dictionary, sized, block, blockBytes, output + i * frame.blockSize, expected);
+        };
+        #ifndef EMSCRIPTEN
+        internal::WorkerPool::shared().forEach(count, decompressBlock);
+        #else
+        // The WebAssembly build has no threads
+        for (size_t i = 0; i < count; i++) {
+            decompressBlock(i);
+        }
+        #endif
+    }
+
+    size_t Decoder::originalSize(const Payload& payload) {
+        if (payload.compressionType == CompressionType::NONE) {
+            return payload.bytes.size();
+        }
+        if (payload.framed) {
+            return parseBlockFrame(payload.compressionType, payload.sized, payload.bytes.data(), payload.bytes.size()).originalSize;
+        }
+        return recordedSize(payload.compressionType, payload.sized, payload.bytes.data(), payload.bytes.size());
+    }
+
+    void Decoder::decompress(const Payload& payload, std::uint8_t* output, size_t outputSize) {
+        const Dictionary* dictionary = payload.dictionary.get();
+        if (payload.compressionType == CompressionType::NONE) {
+            std::copy(payload.bytes.begin(), payload.bytes.end(), output);
+        } else if (payload.framed) {
+            decompressBlocks(payload.compressionType, dictionary, payload.sized, payload.bytes.data(), payload.bytes.size(), output, outputSize);
+        } else {
+            decompress(payload.compressionType, dictionary, payload.sized, payload.bytes.data(), payload.bytes.size(), output, outputSize);
+        }
+    }
+
     std::vector<std::uint8_t> decodeInternal(const std::string& encodedString, CompressionType& outCompressionType) {
+        return Decoder::local().decodeInternal(encodedString, outCompressionType, DecodeOptions());
+    }
+
+    std::vector<std::uint8_t> decodeInternal(const std::string& encodedString, CompressionType& outCompressionType, const DecodeOptions& options) {
+        return Decoder::local().decodeInternal(encodedString, outCompressionType, options);
+    }
+
+    DecodeResult decodeInto(const std::string& encodedString, std::uint8_t* output, size_t capacity, const DecodeOptions& options) {
+        return Decoder::local().decodeInto(encodedString, output, capacity, options);
+    }
+
+    CompressionType decodeInto(const std::string& encodedString, std::vector<std::uint8_t>& buffer, const DecodeOptions& options) {
+        return Decoder::local().decodeInto(encodedString, buffer, options);
+    }
+
+    std::vector<std::uint8_t> Decoder::decodeInternal(const std::string& encodedString, CompressionType& outCompressionType, const DecodeOptions& options) {
+        std::vector<std::uint8_t> decoded;
+        outCompressionType = decodeInto(encodedString, decoded, options);
+        return decoded;
+    }
+
+    DecodeResult Decoder::decodeInto(const std::string& encodedString, std::uint8_t* output, size_t capacity, const DecodeOptions& options) {
+        Payload payload = parse(encodedString, options);
+        DecodeResult result;
+        result.compressionType = payload.compressionType;
+
+        result.size = originalSize(payload);
+        if (result.size == unknownSize) {
+            // Only decompressing tells the size of streamed tokens
+            std::vector<std::uint8_t> decoded = decompress(payload.compressionType, payload.dictionary.get(), payload.bytes.data(), payload.bytes.size());
+            result.size = decoded.size();
+            result.fits = decoded.size() <= capacity;
+            if (result.fits) {
+                std::copy(decoded.begin(), decoded.end(), output);
+            }
+            return result;
+        }
+
+        result.fits = result.size <= capacity;
+        if (result.fits) {
+            decompress(payload, output, result.size);
+        }
+        return result;
+    }
+
+    CompressionType Decoder::decodeInto(const std::string& encodedString, std::vector<std::uint8_t>& buffer, const DecodeOptions& options) {
+        Payload payload = parse(encodedString, options);
+        if (payload.compressionType == CompressionType::NONE) {
+            // The converted bytes are the data
+            keepInto(buffer, payload.bytes);
+            return payload.compressionType;
+        }
+
+        const size_t size = originalSize(payload);
+        if (size == unknownSize) {
+            std::vector<std::uint8_t> decoded = decompress(payload.compressionType, payload.dictionary.get(), payload.bytes.data(), payload.bytes.size());
+            keepInto(buffer, decoded);
+        } else {
+            buffer.resize(size);
+            decompress(payload, buffer.data(), size);
+        }
+        return payload.compressionType;
+    }
+
+    Decoder::Payload Decoder::parse(const std::string& encodedString, const DecodeOptions& options) {
         // Parse the encoded string format: header + ":" + encoded data + ":" + checksum
         size_t firstColon = encodedString.find(':');
         size_t lastColon = encodedString.rfind(':');
@@ -130,8 +588,11 @@ namespace UQPack {
         std::string encodedData = encodedString.substr(firstColon + 1, lastColon - firstColon - 1);
         std::string checksumStr = encodedString.substr(lastColon + 1);
         
+        // "PQ" marks a QR token: Base45 digits with a QR-safe checksum
+        const bool qrToken = header.length() >= 4 && header.compare(0, 2, "PQ") == 0;
+
         // Calculate checksum using the common implementation
-        std::string computedChecksumStr = calculateChecksum(encodedData);
+        std::string computedChecksumStr = qrToken ? calculateQrChecksum(encodedData) : calculateChecksum(encodedData);
         
         // Validate checksum
         if (checksumStr != computedChecksumStr) {
@@ -139,7 +600,7 @@ namespace UQPack {
         }
         
         // Validate header format
-        if (header.length() != 4 || header.substr(0, 2) != "PX") {
+        if (header.length() < 4 || (header.substr(0, 2) != "PX" && !qrToken)) {
             throw std::runtime_error("Invalid header format");
         }
         
@@ -161,10 +622,46 @@ namespace UQPack {
         // Bit 0 (0x1): LZ4 compression used
         // Bit 1 (0x2): Zstd compression used
         // Bit 2 (0x4): Brotli compression used
-        // Bit 3 (0x8): Reserved for future use
+        // Bits 0 and 1 together (0x3): raw DEFLATE used
+        // Bit 3 (0x8): Compressed with a dictionary; its id follows the flags in hex
         bool useLZ4 = (compressionFlags & 0x1) != 0;
         bool useZstd = (compressionFlags & 0x2) != 0;
         bool useBrotli = (compressionFlags & 0x4) != 0;
+        bool useDeflate = (compressionFlags & 0x7) == 0x3;
+        bool useDictionary = (compressionFlags & 0x8) != 0;
+        if (useDeflate) {
+            useLZ4 = false;
+            useZstd = false;
+        }
+
+        std::uint32_t dictionaryId = 0;
+        if (useDictionary) {
+            if (header.length() < 5 || header.length() > 12) {
+                throw std::runtime_error("Invalid dictionary id in header");
+            }
+            for (size_t i = 4; i < header.length(); i++) {
+                const char c = header[i];
+                int digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else {
+                    throw std::runtime_error("Invalid dictionary id in header");
+                }
+                dictionaryId = (dictionaryId << 4) | static_cast<std::uint32_t>(digit);
+            }
+            if (!useLZ4 && !useZstd && !useBrotli && !useDeflate) {
+                throw std::runtime_error("Dictionary compression requires a compression type");
+            }
+            if (useDeflate) {
+                throw std::runtime_error("DEFLATE compression does not support dictionaries");
+            }
+        } else if (header.length() != 4) {
+            throw std::runtime_error("Invalid header format");
+        }
         
         // Validate compression flags - only one compression type should be set
         if (useLZ4 && useZstd) {
@@ -186,42 +683,49 @@ namespace UQPack {
         }
         
         // Determine which base was used for encoding
-        int baseIndex = (encodingFlags & 0x1) ? 1 : 0;
+        int baseIndex = qrToken ? 2 : (encodingFlags & 0x1) ? 1 : 0;
+
+        // Bit 3 (0x8): fixed-width block conversion instead of one big integer
+        bool useBlocks = (encodingFlags & 0x8) != 0;
+
+        // Bit 1 (0x2): Brotli payloads start with their original size
+        bool sized = (encodingFlags & 0x2) != 0;
+
+        // Bit 2 (0x4): the payload is a frame of independently compressed blocks
+        bool useFramedBlocks = (encodingFlags & 0x4) != 0;
+        if (useFramedBlocks && !useLZ4 && !useZstd && !useBrotli && !useDeflate) {
+            throw std::runtime_error("Block framing requires a compression type");
+        }
 
-        std::string charset = basesCharSet[baseIndex];
-        const int base = charset.length();
-        
         // Convert from base-N to bytes
-        std::vector<std::uint8_t> decodedData = convertFromBase(encodedData, charset);
-        
-        // Set output parameters
-        outCompressionType = CompressionType::NONE;
-        
-        // Handle decompression if needed
-        if (useLZ4) {
-            #ifndef EMSCRIPTEN
-            outCompressionType = CompressionType::LZ4;
-            // Get original size from the first 4 bytes. This is necessary for lz4 which does not support dynamically allocating memory during decompression
-            if (decodedData.size() < 4) {
-                throw std::runtime_error("Invalid compressed data: too short");
-            }
-            size_t originalSize = *reinterpret_cast<uint32_t*>(decodedData.data());
-            decodedData = decompressWithLZ4(decodedData.data() + 4, decodedData.size() - 4, originalSize);
-            #else
-            throw std::runtime_error("LZ4 compression not supported on this platform");
-            #endif
-        } else if (useZstd) {
-            #ifndef EMSCRIPTEN
-            outCompressionType = CompressionType::ZSTD;
-            decodedData = decompressWithZstd(decodedData.data(), decodedData.size());
-            #else
-            throw std::runtime_error("Zstd compression not supported on this platform");
-            #endif
-        } else if (useBrotli) {
-            outCompressionType = CompressionType::BROTLI;
-            decodedData = decompressWithBrotli(decodedData.data(), decodedData.size());
+        std::vector<std::uint8_t> decodedData;
+        if (qrToken) {
+            decodedData = convertFromBase45(encodedData);
+        } else if (useBlocks) {
+            decodedData = baseIndex == 0 ? convertFromBaseBlocks<Base64UrlAlphabet>(encodedData) : convertFromBaseBlocks<Base70Alphabet>(encodedData);
+        } else if (baseIndex == 0) {
+            decodedData = convertFromBase64Url(encodedData);
+        } else {
+            RadixParallelism parallelism;
+            parallelism.threads = options.threads;
+            parallelism.thresholdBytes = options.parallelThreshold;
+            decodedData = convertFromBase<Base70Alphabet>(encodedData, parallelism);
         }
         
-        return decodedData;
+        Payload payload;
+        payload.compressionType = useDeflate ? CompressionType::DEFLATE
+                                : useLZ4 ? CompressionType::LZ4
+                                : useZstd ? CompressionType::ZSTD
+                                : useBrotli ? CompressionType::BROTLI
+                                : CompressionType::NONE;
+        payload.sized = sized;
+        payload.framed = useFramedBlocks;
+        payload.bytes = std::move(decodedData);
+
+        // The dictionary named in the header, shared by whichever codec was used
+        if (useDictionary) {
+            payload.dictionary = DictionaryRegistry::global().get(dictionaryId);
+        }
+        return payload;
     }
 }
@@ -0,0 +1,286 @@
+#include <dictionary.hpp>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef EMSCRIPTEN
+#include <lz4.h>
+#include <zstd.h>
+#include <brotli/encode.h>
+#endif
+
+namespace UQPack {
+    namespace {
+        // Quality the Brotli dictionary is prepared for; matches the default brotliQuality
+        constexpr int brotliDictionaryQuality = 11;
+
+        // Read-only mapping of a whole file
+        struct MappedFile {
+            const std::uint8_t* data = nullptr;
+            size_t size = 0;
+
+            explicit MappedFile(const std::string& path) {
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    throw std::runtime_error("Cannot open dictionary file " + path);
+                }
+                struct stat info;
+                if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                    close(fd);
+                    throw std::runtime_error("Dictionary file " + path + " is empty or unreadable");
+                }
+                void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                close(fd);
+                if (mapping == MAP_FAILED) {
+                    throw std::runtime_error("Cannot map dictionary file " + path);
+                }
+                data = static_cast<const std::uint8_t*>(mapping);
+                size = static_cast<size_t>(info.st_size);
+            }
+
+            ~MappedFile() {
+                munmap(const_cast<std::uint8_t*>(data), size);
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+        };
+
+        // A trained dictionary's own id is what zstd writes into (and checks against)
+        // frames; raw content needs an explicit one
+        std::uint32_t resolveId(const std::uint8_t* data, size_t size, std::uint32_t id) {
+            #ifndef EMSCRIPTEN
+            const unsigned embeddedId = ZSTD_getDictID_fromDict(data, size);
+            if (embeddedId != 0) {
+                if (id != 0 && id != embeddedId) {
+                    throw std::runtime_error("Dictionary id " + std::to_string(id) + " does not match its embedded id " + std::to_string(embeddedId));
+                }
+                id = embeddedId;
+            }
+            #endif
+            if (id == 0) {
+                throw std::runtime_error("Raw content dictionaries need an explicit id");
+            }
+            return id;
+        }
+    }
+
+    Dictionary::Dictionary(std::uint32_t id, std::vector<std::uint8_t> content)
+        : dictionaryId(id), bytes(std::move(content)), contentData(bytes.data()), contentSize(bytes.size()) {
+        if (dictionaryId == 0) {
+            throw std::runtime_error("Dictionary id must not be 0");
+        }
+    }
+
+    Dictionary::Dictionary(std::uint32_t id, const std::uint8_t* data, size_t size, std::shared_ptr<const void> owner)
+        : dictionaryId(id), storage(std::move(owner)), contentData(data), contentSize(size) {
+        if (dictionaryId == 0) {
+            throw std::runtime_error("Dictionary id must not be 0");
+        }
+    }
+
+    Dictionary::~Dictionary() {
+        #ifndef EMSCRIPTEN
+        ZSTD_freeCDict(zstdCDict);
+        ZSTD_freeDDict(zstdDDict);
+        #ifdef UQPACK_BROTLI_DICTIONARIES
+        BrotliEncoderDestroyPreparedDictionary(brotliPrepared);
+        #endif
+        LZ4_freeStream(lz4Stream);
+        #endif
+    }
+
+    // Every digested form references the content, which lives as long as this object.
+    // If digesting fails, the exception reaches the caller and the next use retries.
+    void Dictionary::digest() const {
+        #ifndef EMSCRIPTEN
+        std::call_once(digested, [this] {
+            ZSTD_CDict* cdict = ZSTD_createCDict(contentData, contentSize, zstdLevel);
+            ZSTD_DDict* ddict = ZSTD_createDDict(contentData, contentSize);
+            if (!cdict || !ddict) {
+                ZSTD_freeCDict(cdict);
+                ZSTD_freeDDict(ddict);
+                throw std::runtime_error("Failed to digest Zstd dictionary " + std::to_string(dictionaryId));
+            }
+
+            BrotliEncoderPreparedDictionaryStruct* prepared = nullptr;
+            #ifdef UQPACK_BROTLI_DICTIONARIES
+            prepared = BrotliEncoderPrepareDictionary(BROTLI_SHARED_DICTIONARY_RAW, contentSize, contentData,
+                                                      brotliDictionaryQuality, nullptr, nullptr, nullptr);
+            if (!prepared) {
+                ZSTD_freeCDict(cdict);
+                ZSTD_freeDDict(ddict);
+                throw std::runtime_error("Failed to prepare Brotli dictionary " + std::to_string(dictionaryId));
+            }
+            #endif
+
+            // Only the last 64 KiB are loaded
+            LZ4_stream_t* stream = LZ4_createStream();
+            if (!stream) {
+                ZSTD_freeCDict(cdict);
+                ZSTD_freeDDict(ddict);
+                #ifdef UQPACK_BROTLI_DICTIONARIES
+                BrotliEncoderDestroyPreparedDictionary(prepared);
+                #endif
+                throw std::runtime_error("Failed to create LZ4 dictionary stream");
+            }
+            LZ4_loadDict(stream, reinterpret_cast<const char*>(contentData), static_cast<int>(contentSize));
+
+            zstdCDict = cdict;
+            zstdDDict = ddict;
+            brotliPrepared = prepared;
+            lz4Stream = stream;
+        });
+        #endif
+    }
+
+    static_assert(std::atomic<const void*>::is_always_lock_free, "Dictionary lookups rely on lock-free pointer loads");
+
+    DictionaryRegistry::DictionaryRegistry()
+        : grace(std::chrono::hours(24)), current(new Snapshot()) {}
+
+    DictionaryRegistry::~DictionaryRegistry() {
+        delete current.load();
+    }
+
+    // Lookups increment readers before loading the snapshot pointer and decrement it
+    // when done (all sequentially consistent). A writer that reads readers == 0 after
+    // swapping in a new snapshot knows every lookup that could have loaded an older one
+    // has finished, and later ones load the new one. Under constant lookup traffic the
+    // replaced snapshots wait for a later update; they are small, and updates are rare.
+    template<typename F>
+    auto DictionaryRegistry::read(F&& lookup) const {
+        struct Pin {
+            std::atomic<size_t>& readers;
+            explicit Pin(std::atomic<size_t>& count) : readers(count) { readers.fetch_add(1); }
+            ~Pin() { readers.fetch_sub(1); }
+        } pin(readers);
+        return lookup(*current.load());
+    }
+
+    template<typename F>
+    void DictionaryRegistry::update(F&& change) {
+        std::lock_guard<std::mutex> lock(writers);
+        auto next = std::make_unique<Snapshot>(*current.load());
+
+        // Drop retired dictionaries whose grace period is over
+        const Clock::time_point now = Clock::now();
+        for (auto it = next->entries.begin(); it != next->entries.end();) {
+            it = it->second.expires <= now ? next->entries.erase(it) : std::next(it);
+        }
+
+        change(*next);
+        replaced.emplace_back(current.exchange(next.release()));
+        if (readers.load() == 0) {
+            replaced.clear();
+        }
+    }
+
+    std::uint32_t DictionaryRegistry::publish(std::shared_ptr<const Dictionary> dictionary) {
+        const std::uint32_t id = dictionary->id();
+        update([&](Snapshot& snapshot) {
+            auto it = snapshot.entries.find(id);
+            if (it == snapshot.entries.end()) {
+                snapshot.entries.emplace(id, Entry{std::move(dictionary)});
+                return;
+            }
+            // Loading the same content again only cancels a retirement
+            const Dictionary& loaded = *it->second.dictionary;
+            if (loaded.size() != dictionary->size() || !std::equal(loaded.data(), loaded.data() + loaded.size(), dictionary->data())) {
+                throw std::runtime_error("Dictionary " + std::to_string(id) + " is already loaded with different content");
+            }
+            it->second.expires = Clock::time_point::max();
+        });
+        return id;
+    }
+
+    std::uint32_t DictionaryRegistry::add(const std::vector<std::uint8_t>& content, std::uint32_t id) {
+        return publish(std::make_shared<const Dictionary>(resolveId(content.data(), content.size(), id), content));
+    }
+
+    std::uint32_t DictionaryRegistry::addFile(const std::string& path, std::uint32_t id) {
+        auto file = std::make_shared<const MappedFile>(path);
+        const std::uint8_t* data = file->data;
+        const size_t size = file->size;
+        return publish(std::make_shared<const Dictionary>(resolveId(data, size, id), data, size, std::move(file)));
+    }
+
+    void DictionaryRegistry::activate(std::uint32_t id) {
+        update([&](Snapshot& snapshot) {
+            auto it = snapshot.entries.find(id);
+            if (it == snapshot.entries.end()) {
+                throw std::runtime_error("Unknown dictionary " + std::to_string(id));
+            }
+            it->second.expires = Clock::time_point::max();
+            if (snapshot.active != 0 && snapshot.active != id) {
+                auto previous = snapshot.entries.find(snapshot.active);
+                if (previous != snapshot.entries.end()) {
+                    previous->second.expires = Clock::now() + grace;
+                }
+            }
+            snapshot.active = id;
+        });
+    }
+
+    std::uint32_t DictionaryRegistry::active() const {
+        return read([](const Snapshot& snapshot) { return snapshot.active; });
+    }
+
+    void DictionaryRegistry::retire(std::uint32_t id) {
+        update([&](Snapshot& snapshot) {
+            auto it = snapshot.entries.find(id);
+            if (it != snapshot.entries.end()) {
+                it->second.expires = Clock::now() + grace;
+            }
+            if (snapshot.active == id) {
+                snapshot.active = 0;
+            }
+        });
+    }
+
+    void DictionaryRegistry::remove(std::uint32_t id) {
+        update([&](Snapshot& snapshot) {
+            snapshot.entries.erase(id);
+            if (snapshot.active == id) {
+                snapshot.active = 0;
+            }
+        });
+    }
+
+    void DictionaryRegistry::setGracePeriod(Clock::duration gracePeriod) {
+        std::lock_guard<std::mutex> lock(writers);
+        grace = gracePeriod;
+    }
+
+    std::shared_ptr<const Dictionary> DictionaryRegistry::find(std::uint32_t id) const {
+        return read([&](const Snapshot& snapshot) -> std::shared_ptr<const Dictionary> {
+            auto it = snapshot.entries.find(id);
+            if (it == snapshot.entries.end()) {
+                return nullptr;
+            }
+            // Retired entries are only purged by the next update, so check the clock here
+            if (it->second.expires != Clock::time_point::max() && it->second.expires <= Clock::now()) {
+                return nullptr;
+            }
+            return it->second.dictionary;
+        });
+    }
+
+    std::shared_ptr<const Dictionary> DictionaryRegistry::get(std::uint32_t id) const {
+        std::shared_ptr<const Dictionary> dictionary = find(id);
+        if (!dictionary) {
+            throw std::runtime_error("Unknown dictionary " + std::to_string(id));
+        }
+        return dictionary;
+    }
+
+    DictionaryRegistry& DictionaryRegistry::global() {
+        static DictionaryRegistry registry;
+        return registry;
+    }
+}
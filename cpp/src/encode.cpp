@@ -1,108 +1,507 @@
 #include <encode.hpp>
 #include <base.hpp>
+#include <base45.hpp>
+#include <base64.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
-#include <iostream>
+#include <exception>
+#define LZ4_STATIC_LINKING_ONLY
 #include <lz4.h>
+#define LZ4_HC_STATIC_LINKING_ONLY
+#include <lz4hc.h>
 #include <zstd.h>
 #include <brotli/encode.h>
+#include <libdeflate.h>
 #include <siphash.hpp>
 #include <common.hpp>
+#include <dictionary.hpp>
+#include <tuner.hpp>
 
 namespace UQPack {
-    // Helper function to calculate a simple hash for auto-selecting baseIndex
-    int calculateBaseIndex(const std::string& input) {
-        unsigned int hash = 0;
-        for (char c : input) {
-            hash = (hash * 31) + c;
+    namespace {
+        // Big-integer conversion grows faster than linearly with the payload, so the
+        // automatic selection only uses it for Base70 up to this many bytes
+        constexpr size_t autoRadixMaxBytes = 64 * 1024;
+
+        // Digits convertToBase produces for data: floor(log_base(value)) + 1, with the
+        // logarithm taken from the top 64 bits of the value
+        size_t integerDigits(const std::vector<std::uint8_t>& data, unsigned base) {
+            auto first = std::find_if(data.begin(), data.end(), [](std::uint8_t byte) { return byte != 0; });
+            const size_t bytes = static_cast<size_t>(data.end() - first);
+            if (bytes == 0) {
+                return 1;
+            }
+            if (base == 64) {
+                const size_t bits = 8 * bytes - static_cast<size_t>(__builtin_clz(*first) - 24);
+                return (bits + 5) / 6;
+            }
+
+            std::uint64_t top = 0;
+            const size_t topBytes = std::min<size_t>(bytes, 8);
+            for (size_t i = 0; i < topBytes; i++) {
+                top = (top << 8) | first[i];
+            }
+            if (bytes == topBytes) {
+                size_t digits = 0;
+                do {
+                    top /= base;
+                    digits++;
+                } while (top > 0);
+                return digits;
+            }
+            const double log2Value = std::log2(static_cast<double>(top)) + 8.0 * static_cast<double>(bytes - topBytes);
+            return static_cast<size_t>(log2Value / std::log2(static_cast<double>(base))) + 1;
+        }
+
+        // RFC 3986 unreserved characters, the ones URLs carry without percent-encoding
+        bool isUnreserved(char c) {
+            return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                   c == '-' || c == '.' || c == '_' || c == '~';
+        }
+
+        // Digits are close to uniformly distributed, so each costs 1 + 2 * escaped / base
+        // characters on average once percent-encoded
+        size_t urlEncodedLength(size_t length, const std::string& charset) {
+            const size_t escaped = static_cast<size_t>(std::count_if(charset.begin(), charset.end(), [](char c) {
+                return !isUnreserved(c);
+            }));
+            return length + (2 * length * escaped + charset.size() / 2) / charset.size();
+        }
+    }
+
+    namespace {
+        // Digits encode() produces for data in basesCharSet[baseIndex]
+        size_t encodedDigits(const std::vector<std::uint8_t>& data, int baseIndex, EncodingMode encodingMode) {
+            const unsigned base = static_cast<unsigned>(basesCharSet[baseIndex].size());
+            if (baseIndex == 2) {
+                return base45EncodedLength(data.size());
+            }
+            if (encodingMode == EncodingMode::BLOCK) {
+                return blockEncodedLength(data.size(), base);
+            }
+            return integerDigits(data, base);
+        }
+
+        // What AUTO compares candidates by: the digits in the charset encode() will use
+        // (as percent-encoded in a URL context) plus the dictionary id in the header.
+        // The rest of the token has the same length for every codec.
+        size_t tokenCost(const std::vector<std::uint8_t>& data, const EncodeOptions& options) {
+            size_t cost;
+            if (options.baseIndex < 0) {
+                BaseSelection selection = selectBaseIndex(data, options);
+                cost = options.urlContext ? selection.urlLength : selection.length;
+            } else if (options.baseIndex == 2 && options.urlContext) {
+                // Base45 digits are far from uniform (they come in fixed groups), so the
+                // average overstates or understates their escapes; converting is linear
+                const std::string digits = convertToBase45(data);
+                cost = digits.size() + 2 * static_cast<size_t>(std::count_if(digits.begin(), digits.end(), [](char c) {
+                    return !isUnreserved(c);
+                }));
+            } else {
+                const size_t length = encodedDigits(data, options.baseIndex, options.encodingMode);
+                cost = options.urlContext ? urlEncodedLength(length, basesCharSet[options.baseIndex]) : length;
+            }
+            for (std::uint32_t id = options.dictionaryId; id != 0; id >>= 4) {
+                cost++;
+            }
+            return cost;
+        }
+    }
+
+    namespace {
+        // ZSTD_CCtx_setParameter rejects values out of range; without the check the
+        // compression would silently run with the defaults
+        void setZstdParameter(ZSTD_CCtx* zstd, ZSTD_cParameter parameter, int value, const char* name) {
+            size_t result = ZSTD_CCtx_setParameter(zstd, parameter, value);
+            if (ZSTD_isError(result)) {
+                throw std::runtime_error("Invalid Zstd " + std::string(name) + " " + std::to_string(value) + ": " +
+                                        std::string(ZSTD_getErrorName(result)));
+            }
+        }
+
+        // Whether compress() splits this input into a frame of blocks
+        bool splitIntoBlocks(const EncodeOptions& options, size_t dataSize) {
+            return options.compressionBlockSize != 0 && dataSize > options.compressionBlockSize &&
+                   options.compressionType != CompressionType::NONE;
+        }
+    }
+
+    BaseSelection selectBaseIndex(const std::vector<std::uint8_t>& data, const EncodeOptions& options) {
+        BaseSelection best;
+        best.baseIndex = -1;
+        for (int i = 0; i < static_cast<int>(basesCharSet.size()); i++) {
+            if (i == 1 && options.encodingMode != EncodingMode::BLOCK && data.size() > autoRadixMaxBytes) {
+                continue;
+            }
+            const size_t length = encodedDigits(data, i, options.encodingMode);
+
+            const size_t urlLength = urlEncodedLength(length, basesCharSet[i]);
+            const size_t cost = options.urlContext ? urlLength : length;
+            if (best.baseIndex < 0 || cost < (options.urlContext ? best.urlLength : best.length)) {
+                best.baseIndex = i;
+                best.length = length;
+                best.urlLength = urlLength;
+            }
+        }
+        return best;
+    }
+
+    EncodeOptions EncodeOptions::preset(CompressionPreset preset) {
+        EncodeOptions options;
+        switch (preset) {
+            case CompressionPreset::LATENCY:
+                options.zstdLevel = 1;
+                options.lz4Acceleration = 4;
+                options.lz4hcLevel = 3;
+                options.deflateLevel = 1;
+                options.brotliQuality = 4;
+                options.brotliWindow = 18;
+                break;
+            case CompressionPreset::BALANCED:
+                options.zstdLevel = 3;
+                options.lz4Acceleration = 1;
+                options.lz4hcLevel = 9;
+                options.deflateLevel = 6;
+                options.brotliQuality = 7;
+                options.brotliWindow = 22;
+                break;
+            case CompressionPreset::SMALLEST:
+                options.zstdLevel = 19;
+                options.lz4Acceleration = 1;
+                options.lz4hcLevel = 12;
+                options.deflateLevel = 12;
+                options.brotliQuality = 11;
+                options.brotliWindow = 24;
+                break;
+        }
+        return options;
+    }
+
+    // Long-lived codec state; see Encoder in encode.hpp
+    struct Encoder::State {
+        ZSTD_CCtx* zstd = nullptr;
+        LZ4_stream_t lz4;
+        LZ4_streamHC_t lz4hc;
+        internal::BlockPool brotliPool;
+        std::vector<std::uint8_t> scratch; // compressor output, copied out at its exact size
+
+        // libdeflate compressors are made for one level; kept while it is requested
+        libdeflate_compressor* deflate = nullptr;
+        int deflateLevel = -1;
+
+        // Zstd dictionary digested for a level other than the shared one's, kept while
+        // the same dictionary and level are requested
+        std::shared_ptr<const Dictionary> levelDictionary;
+        int levelDictionaryLevel = 0;
+        ZSTD_CDict* levelCDict = nullptr;
+
+        State() {
+            zstd = ZSTD_createCCtx();
+            if (!zstd) {
+                throw std::runtime_error("Failed to create Zstd compression context");
+            }
+            LZ4_initStream(&lz4, sizeof(lz4));
+            LZ4_initStreamHC(&lz4hc, sizeof(lz4hc));
+        }
+
+        ~State() {
+            ZSTD_freeCDict(levelCDict);
+            ZSTD_freeCCtx(zstd);
+            libdeflate_free_compressor(deflate);
         }
-        return 0;
-        // return hash % 2; // Choose among 0 or 1
+
+        libdeflate_compressor* deflateCompressor(int level) {
+            if (level != deflateLevel) {
+                libdeflate_free_compressor(deflate);
+                deflateLevel = -1;
+                deflate = libdeflate_alloc_compressor(level);
+                if (!deflate) {
+                    throw std::runtime_error("Failed to create DEFLATE compressor for level " + std::to_string(level));
+                }
+                deflateLevel = level;
+            }
+            return deflate;
+        }
+
+        const ZSTD_CDict* zstdDictionary(const std::shared_ptr<const Dictionary>& dictionary, int level) {
+            if (level == Dictionary::zstdLevel) {
+                return dictionary->zstdCompression();
+            }
+            if (dictionary != levelDictionary || level != levelDictionaryLevel) {
+                ZSTD_freeCDict(levelCDict);
+                levelDictionary.reset();
+                levelCDict = ZSTD_createCDict(dictionary->data(), dictionary->size(), level);
+                if (!levelCDict) {
+                    throw std::runtime_error("Failed to digest Zstd dictionary " + std::to_string(dictionary->id()));
+                }
+                levelDictionary = dictionary;
+                levelDictionaryLevel = level;
+            }
+            return levelCDict;
+        }
+
+        std::uint8_t* reserve(size_t size) {
+            if (scratch.size() < size) {
+                scratch.resize(size);
+            }
+            return scratch.data();
+        }
+    };
+
+    Encoder::Encoder() : state(new State()) {}
+
+    Encoder::~Encoder() = default;
+
+    Encoder& Encoder::local() {
+        thread_local Encoder encoder;
+        return encoder;
+    }
+
+    std::vector<std::uint8_t> Encoder::compressWithLZ4(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId) {
+        EncodeOptions options;
+        options.dictionaryId = dictionaryId;
+        return compressWithLZ4(data, dataSize, options);
     }
 
-    // Helper function to compress data using LZ4
-    std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize) {
-        // Allocate a buffer for compression (worst case size)
+    // Compress data using LZ4, optionally with a registered dictionary as its prefix
+    std::vector<std::uint8_t> Encoder::compressWithLZ4(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        const std::uint32_t dictionaryId = options.dictionaryId;
+        // Allocate a buffer for compression (worst case size) behind a custom header
+        // (4 bytes) containing the original data size
         int maxCompressedSize = LZ4_compressBound(dataSize);
-        std::vector<std::uint8_t> compressBuffer(maxCompressedSize);
-        
-        // Compress the data
-        int compressedSize = LZ4_compress_default(
-            reinterpret_cast<const char*>(data),
-            reinterpret_cast<char*>(compressBuffer.data()),
-            dataSize,
-            maxCompressedSize
-        );
+        std::uint8_t* buffer = state->reserve(4 + maxCompressedSize);
+
+        int compressedSize;
+        if (dictionaryId != 0) {
+            // Reference the preloaded dictionary stream in place instead of loading
+            // the dictionary into our own stream on every call
+            std::shared_ptr<const Dictionary> dictionary = DictionaryRegistry::global().get(dictionaryId);
+            LZ4_resetStream_fast(&state->lz4);
+            LZ4_attach_dictionary(&state->lz4, dictionary->lz4Compression());
+            compressedSize = LZ4_compress_fast_continue(
+                &state->lz4,
+                reinterpret_cast<const char*>(data),
+                reinterpret_cast<char*>(buffer + 4),
+                dataSize,
+                maxCompressedSize,
+                options.lz4Acceleration
+            );
+            // Drop the history referencing data and the dictionary
+            LZ4_attach_dictionary(&state->lz4, nullptr);
+        } else {
+            // Same output as LZ4_compress_default, without clearing the state every call
+            compressedSize = LZ4_compress_fast_extState_fastReset(
+                &state->lz4,
+                reinterpret_cast<const char*>(data),
+                reinterpret_cast<char*>(buffer + 4),
+                dataSize,
+                maxCompressedSize,
+                options.lz4Acceleration
+            );
+        }
         
         if (compressedSize <= 0) {
             throw std::runtime_error("LZ4 compression failed");
         }
-        
-                // Return only the compressed portion
-        compressBuffer.resize(compressedSize);
 
-        // Prepend a custom header (4 bytes) containing the original data size.
-        std::vector<std::uint8_t> finalBuffer(4 + compressBuffer.size());
-        *reinterpret_cast<uint32_t*>(finalBuffer.data()) = static_cast<uint32_t>(dataSize);
-        std::copy(compressBuffer.begin(), compressBuffer.end(), finalBuffer.begin() + 4);
-        
-        return finalBuffer;
+        *reinterpret_cast<uint32_t*>(buffer) = static_cast<uint32_t>(dataSize);
+        return std::vector<std::uint8_t>(buffer, buffer + 4 + compressedSize);
     }
 
-    // Helper function to compress data using Brotli
-    std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality) {
+    // Compress data using LZ4HC. The output is an ordinary LZ4 block behind the same
+    // 4-byte size header, so it decodes like compressWithLZ4's.
+    std::vector<std::uint8_t> Encoder::compressWithLZ4HC(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        // LZ4HC would quietly use its default level below 1 and its maximum above 12
+        if (options.lz4hcLevel < 1 || options.lz4hcLevel > LZ4HC_CLEVEL_MAX) {
+            throw std::runtime_error("LZ4HC level must be 1 to " + std::to_string(LZ4HC_CLEVEL_MAX) + ", got " + std::to_string(options.lz4hcLevel));
+        }
+        int maxCompressedSize = LZ4_compressBound(dataSize);
+        std::uint8_t* buffer = state->reserve(4 + maxCompressedSize);
+
+        int compressedSize;
+        if (options.dictionaryId != 0) {
+            // HC tables depend on the level, so the dictionary is indexed at the requested
+            // one rather than attached from a shared preloaded stream
+            std::shared_ptr<const Dictionary> dictionary = DictionaryRegistry::global().get(options.dictionaryId);
+            LZ4_resetStreamHC_fast(&state->lz4hc, options.lz4hcLevel);
+            LZ4_loadDictHC(&state->lz4hc, reinterpret_cast<const char*>(dictionary->data()), static_cast<int>(dictionary->size()));
+            compressedSize = LZ4_compress_HC_continue(
+                &state->lz4hc,
+                reinterpret_cast<const char*>(data),
+                reinterpret_cast<char*>(buffer + 4),
+                dataSize,
+                maxCompressedSize
+            );
+        } else {
+            compressedSize = LZ4_compress_HC_extStateHC_fastReset(
+                &state->lz4hc,
+                reinterpret_cast<const char*>(data),
+                reinterpret_cast<char*>(buffer + 4),
+                dataSize,
+                maxCompressedSize,
+                options.lz4hcLevel
+            );
+        }
+
+        if (compressedSize <= 0) {
+            throw std::runtime_error("LZ4HC compression failed");
+        }
+
+        *reinterpret_cast<uint32_t*>(buffer) = static_cast<uint32_t>(dataSize);
+        return std::vector<std::uint8_t>(buffer, buffer + 4 + compressedSize);
+    }
+
+    // Compress data to raw DEFLATE with libdeflate. Like Brotli's, the stream follows the
+    // original size as a varint, since DEFLATE does not record it and libdeflate
+    // decompresses in one call into a buffer of known size.
+    std::vector<std::uint8_t> Encoder::compressWithDeflate(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        if (options.dictionaryId != 0) {
+            throw std::runtime_error("DEFLATE compression does not support dictionaries");
+        }
+        libdeflate_compressor* compressor = state->deflateCompressor(options.deflateLevel);
+
+        std::vector<std::uint8_t> prefix;
+        internal::appendVarint(prefix, dataSize);
+        const size_t maxCompressedSize = libdeflate_deflate_compress_bound(compressor, dataSize);
+        std::uint8_t* buffer = state->reserve(prefix.size() + maxCompressedSize);
+        std::copy(prefix.begin(), prefix.end(), buffer);
+
+        size_t compressedSize = libdeflate_deflate_compress(compressor, data, dataSize, buffer + prefix.size(), maxCompressedSize);
+        if (compressedSize == 0) {
+            throw std::runtime_error("DEFLATE compression failed");
+        }
+        return std::vector<std::uint8_t>(buffer, buffer + prefix.size() + compressedSize);
+    }
+
+    std::vector<std::uint8_t> Encoder::compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality, std::uint32_t dictionaryId) {
+        EncodeOptions options;
+        options.brotliQuality = quality;
+        options.dictionaryId = dictionaryId;
+        return compressWithBrotli(data, dataSize, options);
+    }
+
+    // Compress data using Brotli, optionally against a registered dictionary
+    std::vector<std::uint8_t> Encoder::compressWithBrotli(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        const std::uint32_t dictionaryId = options.dictionaryId;
+        // The encoder clamps parameters out of range instead of failing
+        if (options.brotliQuality < BROTLI_MIN_QUALITY || options.brotliQuality > BROTLI_MAX_QUALITY) {
+            throw std::runtime_error("Brotli quality must be 0 to 11, got " + std::to_string(options.brotliQuality));
+        }
+        if (options.brotliWindow < BROTLI_MIN_WINDOW_BITS || options.brotliWindow > BROTLI_MAX_WINDOW_BITS) {
+            throw std::runtime_error("Brotli window must be 10 to 24, got " + std::to_string(options.brotliWindow));
+        }
+
         // Calculate maximum compressed size
         size_t maxCompressedSize = BrotliEncoderMaxCompressedSize(dataSize);
         if (maxCompressedSize == 0) {
             throw std::runtime_error("Failed to calculate Brotli maximum compressed size");
         }
 
-        std::vector<std::uint8_t> compressBuffer(maxCompressedSize);
-        size_t encodedSize = maxCompressedSize;
+        // Brotli states cannot be reset, so a fresh one is built on pooled memory. With the
+        // default options the parameters are the ones BrotliEncoderCompress(11,
+        // BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE) uses, which gives the same output.
+        BrotliEncoderState* brotli = BrotliEncoderCreateInstance(internal::BlockPool::allocate, internal::BlockPool::release, &state->brotliPool);
+        if (!brotli) {
+            throw std::runtime_error("Failed to create Brotli encoder instance");
+        }
+        BrotliEncoderSetParameter(brotli, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(options.brotliQuality));
+        BrotliEncoderSetParameter(brotli, BROTLI_PARAM_LGWIN, static_cast<uint32_t>(options.brotliWindow));
+        BrotliEncoderSetParameter(brotli, BROTLI_PARAM_MODE, options.brotliMode == BrotliMode::TEXT ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC);
+        BrotliEncoderSetParameter(brotli, BROTLI_PARAM_SIZE_HINT, static_cast<uint32_t>(std::min<size_t>(dataSize, 1u << 30)));
+
+        // The prepared dictionary is shared read-only; holding it keeps it alive until
+        // the state that references it is destroyed
+        std::shared_ptr<const Dictionary> dictionary;
+        if (dictionaryId != 0) {
+            dictionary = DictionaryRegistry::global().find(dictionaryId);
+            if (!dictionary) {
+                BrotliEncoderDestroyInstance(brotli);
+                throw std::runtime_error("Unknown dictionary " + std::to_string(dictionaryId));
+            }
+            #ifdef UQPACK_BROTLI_DICTIONARIES
+            if (!BrotliEncoderAttachPreparedDictionary(brotli, dictionary->brotliCompression())) {
+                BrotliEncoderDestroyInstance(brotli);
+                throw std::runtime_error("Failed to attach Brotli dictionary");
+            }
+            #else
+            BrotliEncoderDestroyInstance(brotli);
+            throw std::runtime_error("Brotli dictionaries need Brotli 1.1.0 or later");
+            #endif
+        }
+
+        // The stream follows the original size as a varint, so the decoder can size its
+        // output exactly, as LZ4's 4-byte prefix does
+        std::vector<std::uint8_t> prefix;
+        internal::appendVarint(prefix, dataSize);
+        std::uint8_t* buffer = state->reserve(prefix.size() + maxCompressedSize);
+        std::copy(prefix.begin(), prefix.end(), buffer);
 
-        // Compress the data
-        if (!BrotliEncoderCompress(
-                quality,  // Quality level (0-11)
-                BROTLI_DEFAULT_WINDOW,  // LZ77 window size
-                BROTLI_DEFAULT_MODE,  // Default compression mode
-                dataSize,  // Input size
-                reinterpret_cast<const uint8_t*>(data),  // Input data
-                &encodedSize,  // Output size (modified in-place)
-                compressBuffer.data()  // Output buffer
-            )) {
+        size_t availableIn = dataSize;
+        const uint8_t* nextIn = data;
+        size_t availableOut = maxCompressedSize;
+        uint8_t* nextOut = buffer + prefix.size();
+        bool ok = BrotliEncoderCompressStream(brotli, BROTLI_OPERATION_FINISH, &availableIn, &nextIn, &availableOut, &nextOut, nullptr) &&
+                  BrotliEncoderIsFinished(brotli);
+        BrotliEncoderDestroyInstance(brotli);
+        if (!ok) {
             throw std::runtime_error("Brotli compression failed");
         }
 
-        // Resize buffer to actual compressed size
-        compressBuffer.resize(encodedSize);
-        return compressBuffer;
+        return std::vector<std::uint8_t>(buffer, nextOut);
+    }
+
+    std::vector<std::uint8_t> Encoder::compressWithZstd(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId) {
+        EncodeOptions options;
+        options.dictionaryId = dictionaryId;
+        return compressWithZstd(data, dataSize, options);
     }
 
-    // Helper function to compress data using zstd
-    std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize) {
+    // Compress data using zstd, optionally against a registered dictionary
+    std::vector<std::uint8_t> Encoder::compressWithZstd(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
         // Calculate the upper bound for the compressed data
         size_t compressBound = ZSTD_compressBound(dataSize);
-        std::vector<std::uint8_t> compressBuffer(compressBound);
+        std::uint8_t* buffer = state->reserve(compressBound);
 
-        // Compress the data
-        size_t compressedSize = ZSTD_compress(
-            compressBuffer.data(),
-            compressBound,
-            reinterpret_cast<const char*>(data),
-            dataSize,
-            1  // Compression level (1-22, higher = better compression but slower)
-        );
+        // Compress the data, reusing the context's tables
+        size_t compressedSize;
+        if (options.dictionaryId != 0) {
+            // The digested dictionary carries the compression parameters
+            std::shared_ptr<const Dictionary> dictionary = DictionaryRegistry::global().get(options.dictionaryId);
+            compressedSize = ZSTD_compress_usingCDict(
+                state->zstd,
+                buffer,
+                compressBound,
+                data,
+                dataSize,
+                state->zstdDictionary(dictionary, options.zstdLevel)
+            );
+        } else if (options.zstdWindowLog == 0 && options.zstdStrategy == ZstdStrategy::DEFAULT) {
+            compressedSize = ZSTD_compressCCtx(
+                state->zstd,
+                buffer,
+                compressBound,
+                reinterpret_cast<const char*>(data),
+                dataSize,
+                options.zstdLevel
+            );
+        } else {
+            ZSTD_CCtx_reset(state->zstd, ZSTD_reset_session_and_parameters);
+            setZstdParameter(state->zstd, ZSTD_c_compressionLevel, options.zstdLevel, "level");
+            setZstdParameter(state->zstd, ZSTD_c_windowLog, options.zstdWindowLog, "window log");
+            setZstdParameter(state->zstd, ZSTD_c_strategy, static_cast<int>(options.zstdStrategy), "strategy");
+            compressedSize = ZSTD_compress2(state->zstd, buffer, compressBound, data, dataSize);
+        }
 
         if (ZSTD_isError(compressedSize)) {
             throw std::runtime_error("Zstd compression failed: " +
                                     std::string(ZSTD_getErrorName(compressedSize)));
         }
 
-        // Resize the buffer to the actual compressed size
-        compressBuffer.resize(compressedSize);
-
         // Check the stored decompressed size in the frame header
-        unsigned long long storedSize = ZSTD_getFrameContentSize(compressBuffer.data(), compressedSize);
+        unsigned long long storedSize = ZSTD_getFrameContentSize(buffer, compressedSize);
         if (storedSize == ZSTD_CONTENTSIZE_ERROR) {
             throw std::runtime_error("Error reading stored decompressed size from compressed data");
         }
@@ -113,46 +512,240 @@ namespace UQPack {
             throw std::runtime_error("Mismatch between original data size and stored decompressed size");
         }
 
-        return compressBuffer;
+        return std::vector<std::uint8_t>(buffer, buffer + compressedSize);
     }
 
-    // Helper function to compress data with the specified compression type
-    std::vector<std::uint8_t> compressData(const std::uint8_t* data, size_t dataSize, CompressionType compressionType) {
-        switch (compressionType) {
+    std::vector<std::uint8_t> Encoder::compress(const std::uint8_t* data, size_t dataSize, CompressionType compressionType, std::uint32_t dictionaryId) {
+        EncodeOptions options;
+        options.compressionType = compressionType;
+        options.dictionaryId = dictionaryId;
+        return compress(data, dataSize, options);
+    }
+
+    // Frame of independently compressed blocks: a version byte (1), block size, original
+    // size, the compressed size of every block, then the blocks, sizes as 32-bit
+    // little-endian. Every block but the last holds exactly block size bytes of input.
+    // The version byte also keeps the frame from starting with a zero byte, which the
+    // integer conversion would drop.
+    std::vector<std::uint8_t> Encoder::compressBlocks(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        const size_t blockSize = options.compressionBlockSize;
+        if (dataSize > UINT32_MAX || blockSize > UINT32_MAX) {
+            throw std::runtime_error("Payload too large for block compression");
+        }
+        const size_t count = (dataSize + blockSize - 1) / blockSize;
+
+        EncodeOptions single = options;
+        single.compressionBlockSize = 0;
+        std::vector<std::vector<std::uint8_t>> blocks(count);
+        internal::WorkerPool::shared().forEach(count, [&](size_t i) {
+            // Workers compress with their own sessions
+            Encoder& encoder = internal::WorkerPool::onWorker() ? Encoder::local() : *this;
+            const size_t offset = i * blockSize;
+            blocks[i] = encoder.compress(data + offset, std::min(blockSize, dataSize - offset), single);
+        });
+
+        const size_t tableSize = 9 + 4 * count;
+        size_t frameSize = tableSize;
+        for (const auto& block : blocks) {
+            frameSize += block.size();
+        }
+        std::vector<std::uint8_t> frame(tableSize);
+        frame.reserve(frameSize);
+        frame[0] = 1;
+        internal::storeSize32(frame.data() + 1, blockSize);
+        internal::storeSize32(frame.data() + 5, dataSize);
+        for (size_t i = 0; i < count; i++) {
+            internal::storeSize32(frame.data() + 9 + 4 * i, blocks[i].size());
+        }
+        for (const auto& block : blocks) {
+            frame.insert(frame.end(), block.begin(), block.end());
+        }
+        return frame;
+    }
+
+    // Compress data with the specified compression type
+    std::vector<std::uint8_t> Encoder::compress(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options) {
+        if (options.dictionaryId != 0 && options.compressionType == CompressionType::NONE) {
+            throw std::runtime_error("Dictionary compression requires a compression type");
+        }
+        if (options.compressionType == CompressionType::AUTO) {
+            throw std::runtime_error("CompressionType::AUTO needs a CodecSelection to report the codec used");
+        }
+        if (splitIntoBlocks(options, dataSize)) {
+            return compressBlocks(data, dataSize, options);
+        }
+        switch (options.compressionType) {
             case CompressionType::LZ4:
-                return compressWithLZ4(data, dataSize);
+                return compressWithLZ4(data, dataSize, options);
+            case CompressionType::LZ4HC:
+                return compressWithLZ4HC(data, dataSize, options);
+            case CompressionType::DEFLATE:
+                return compressWithDeflate(data, dataSize, options);
             case CompressionType::ZSTD:
-                return compressWithZstd(data, dataSize);
+                return compressWithZstd(data, dataSize, options);
             case CompressionType::BROTLI:
-                return compressWithBrotli(data, dataSize, 11);
+                return compressWithBrotli(data, dataSize, options);
             case CompressionType::NONE:
             default:
                 // No compression, just copy the data
-                return std::vector<std::uint8_t>(reinterpret_cast<const std::uint8_t*>(data), reinterpret_cast<const std::uint8_t*>(data) + dataSize);
+                return std::vector<std::uint8_t>(data, data + dataSize);
+        }
+    }
+
+    std::vector<std::uint8_t> Encoder::compress(const std::uint8_t* data, size_t dataSize, const EncodeOptions& options, CodecSelection& selection) {
+        if (options.compressionType != CompressionType::AUTO) {
+            std::vector<std::uint8_t> compressed = compress(data, dataSize, options);
+            selection.compressionType = options.compressionType;
+            selection.originalSize = dataSize;
+            selection.compressedSize = compressed.size();
+            selection.length = tokenCost(compressed, options);
+            selection.framed = splitIntoBlocks(options, dataSize);
+            return compressed;
+        }
+
+        // NONE first, so that ties go to it and then to the earlier candidates
+        std::vector<EncodeOptions> candidates(1, options);
+        candidates[0].compressionType = CompressionType::NONE;
+        candidates[0].dictionaryId = 0;
+        for (CompressionType type : options.autoCandidates) {
+            // DEFLATE cannot use the dictionary, which the other candidates will
+            bool tried = type == CompressionType::AUTO || (type == CompressionType::DEFLATE && options.dictionaryId != 0);
+            for (const EncodeOptions& candidate : candidates) {
+                tried = tried || candidate.compressionType == type;
+            }
+            if (!tried) {
+                candidates.push_back(options);
+                candidates.back().compressionType = type;
+            }
+        }
+
+        std::vector<std::vector<std::uint8_t>> results(candidates.size());
+        if (options.autoParallel && candidates.size() > 1 && !internal::WorkerPool::onWorker()) {
+            // The workers use their own sessions; this thread takes the last candidate
+            std::vector<std::future<std::vector<std::uint8_t>>> pending;
+            for (size_t i = 0; i + 1 < candidates.size(); i++) {
+                const EncodeOptions* candidate = &candidates[i];
+                pending.push_back(internal::WorkerPool::shared().submit([data, dataSize, candidate] {
+                    return Encoder::local().compress(data, dataSize, *candidate);
+                }));
+            }
+            std::exception_ptr error;
+            try {
+                results.back() = compress(data, dataSize, candidates.back());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Every trial reads data and candidates, so wait for all before leaving
+            for (size_t i = 0; i < pending.size(); i++) {
+                try {
+                    results[i] = pending[i].get();
+                } catch (...) {
+                    error = error ? error : std::current_exception();
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } else {
+            for (size_t i = 0; i < candidates.size(); i++) {
+                results[i] = compress(data, dataSize, candidates[i]);
+            }
+        }
+
+        size_t best = 0;
+        size_t bestCost = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            const size_t cost = tokenCost(results[i], candidates[i]);
+            if (i == 0 || cost < bestCost) {
+                best = i;
+                bestCost = cost;
+            }
         }
+        selection.compressionType = candidates[best].compressionType;
+        selection.originalSize = dataSize;
+        selection.compressedSize = results[best].size();
+        selection.length = bestCost;
+        selection.framed = splitIntoBlocks(candidates[best], dataSize);
+        return std::move(results[best]);
+    }
+
+    std::vector<std::uint8_t> compressWithLZ4(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId) {
+        return Encoder::local().compressWithLZ4(data, dataSize, dictionaryId);
+    }
+
+    std::vector<std::uint8_t> compressWithBrotli(const std::uint8_t* data, size_t dataSize, int quality, std::uint32_t dictionaryId) {
+        return Encoder::local().compressWithBrotli(data, dataSize, quality, dictionaryId);
+    }
+
+    std::vector<std::uint8_t> compressWithZstd(const std::uint8_t* data, size_t dataSize, std::uint32_t dictionaryId) {
+        return Encoder::local().compressWithZstd(data, dataSize, dictionaryId);
     }
 
     // Low-level encode function for binary data with compression type
-    std::string encode(const std::vector<std::uint8_t>& data, CompressionType compressionType, int baseIndex) {
-        std::string charset = basesCharSet[baseIndex];
-        std::string encoded = convertToBase(data, charset);
+    std::string encode(const std::vector<std::uint8_t>& data, CompressionType compressionType, int baseIndex, EncodingMode encodingMode) {
+        EncodeOptions options;
+        options.compressionType = compressionType;
+        options.baseIndex = baseIndex;
+        options.encodingMode = encodingMode;
+        return encode(data, options);
+    }
+
+    // Encode JSON data with compression type
+    std::string encode(const json& jsonData, CompressionType compressionType, int baseIndex, EncodingMode encodingMode) {
+        EncodeOptions options;
+        options.compressionType = compressionType;
+        options.baseIndex = baseIndex;
+        options.encodingMode = encodingMode;
+        return encode(jsonData, options);
+    }
+
+    // Low-level encode function for binary data with explicit options
+    std::string encode(const std::vector<std::uint8_t>& data, const EncodeOptions& options) {
+        const CompressionType compressionType = options.compressionType;
+        if (compressionType == CompressionType::AUTO) {
+            throw std::runtime_error("CompressionType::AUTO needs uncompressed input: use Encoder::compress with a CodecSelection");
+        }
+        const int baseIndex = options.baseIndex < 0 ? selectBaseIndex(data, options).baseIndex : options.baseIndex;
+        const EncodingMode encodingMode = options.encodingMode;
+
+        // Base45 tokens are meant for QR codes: "PQ" instead of "PX" marks them, since
+        // the digits, the checksum and the header all stay in the QR alphanumeric set
+        const bool qrToken = baseIndex == 2;
+
+        std::string encoded;
+        if (qrToken) {
+            // Base45 is always converted in 2-byte groups, so the encoding mode does not apply
+            encoded = convertToBase45(data);
+        } else if (encodingMode == EncodingMode::BLOCK) {
+            encoded = baseIndex == 0 ? convertToBaseBlocks<Base64UrlAlphabet>(data) : convertToBaseBlocks<Base70Alphabet>(data);
+        } else if (baseIndex == 0) {
+            // Base64 is a power of two, so the digits are a plain bit regrouping
+            encoded = convertToBase64Url(data);
+        } else {
+            RadixParallelism parallelism;
+            parallelism.threads = options.threads;
+            parallelism.thresholdBytes = options.parallelThreshold;
+            encoded = convertToBase<Base70Alphabet>(data, parallelism);
+        }
 
         // Calculate checksum using the common implementation
-        std::string checksumStr = calculateChecksum(encoded);
+        std::string checksumStr = qrToken ? calculateQrChecksum(encoded) : calculateChecksum(encoded);
 
-        // Build header: "PX" + compression flag (4 bits) + encoding/cipher flag (4 bits)
-        std::string header = "PX";
+        // Build header: "PX" (or "PQ") + compression flag (4 bits) + encoding/cipher flag (4 bits)
+        std::string header = qrToken ? "PQ" : "PX";
         
         // Create a 4-bit flag (represented as a hex digit) to indicate the compression used:
         // Bit 0 (0x1): LZ4 compression used
         // Bit 1 (0x2): Zstd compression used
         // Bit 2 (0x4): Brotli compression used
-        // Bit 3 (0x8): Reserve for future use
+        // Bits 0 and 1 together (0x3): raw DEFLATE used
+        // Bit 3 (0x8): Compressed with a dictionary; its id follows the flags in hex
         int compressionFlags = 0;
         
         // Set compression flags based on the compression type
         switch (compressionType) {
             case CompressionType::LZ4:
+            case CompressionType::LZ4HC: // same block format
                 compressionFlags |= 0x1;
                 break;
             case CompressionType::ZSTD:
@@ -161,22 +754,38 @@ namespace UQPack {
             case CompressionType::BROTLI:
                 compressionFlags |= 0x4;
                 break;
+            case CompressionType::DEFLATE:
+                compressionFlags |= 0x3;
+                break;
             case CompressionType::NONE:
             default:
                 // No compression flags set
                 break;
         }
+
+        if (options.dictionaryId != 0) {
+            if (compressionType == CompressionType::NONE) {
+                throw std::runtime_error("Dictionary compression requires a compression type");
+            }
+            compressionFlags |= 0x8;
+        }
+        if (options.framedBlocks && compressionType == CompressionType::NONE) {
+            throw std::runtime_error("Block framing requires a compression type");
+        }
         
         // Create a 4-bit flag (represented as a hex digit) to indicate the encoding and cipher process:
         // First bit (0x1) - Encoding step:
         //   0x0 - Base64
         //   0x1 - Base70
-        // Next 3 bits - Cipher steps:
-        //   0x0 - Reverse bytes only
-        //   0x1 - Caesar cipher only
-        //   0x2 - Reverse bytes + Caesar cipher
-        //   0x3 - Caesar cipher + Reverse bytes
-        //   0x4-0x8 - Reserved for future use
+        // Second bit (0x2) - Brotli payloads start with their original size (varint);
+        //   set for every Brotli token but streamed ones
+        // Third bit (0x4) - Compression:
+        //   0x0 - One compressed payload
+        //   0x4 - Frame of independently compressed blocks (see Encoder::compressBlocks)
+        // Last bit (0x8) - Conversion:
+        //   0x0 - Whole payload as one integer
+        //   0x8 - Fixed-width blocks (8 bytes per block)
+        // "PQ" tokens are always Base45 and leave the first and last bits at 0
         int encodingFlags = 0;
         
         // Set encoding bit (first bit) based on baseIndex
@@ -184,9 +793,18 @@ namespace UQPack {
             encodingFlags |= 0x1;
         }
         // Note: baseIndex 0 (Base64) will have encoding bit 0
-        
-        // For now, we'll default to "Reverse bytes only" (0x0) for the cipher steps
-        // This can be expanded later when cipher implementations are added
+
+        if (encodingMode == EncodingMode::BLOCK && !qrToken) {
+            encodingFlags |= 0x8;
+        }
+
+        if (compressionType == CompressionType::BROTLI) {
+            encodingFlags |= 0x2;
+        }
+
+        if (options.framedBlocks) {
+            encodingFlags |= 0x4;
+        }
         
         // Convert compression flags to hex digit (0-F)
         char compressionHex = (compressionFlags < 10) ? ('0' + compressionFlags) : ('A' + compressionFlags - 10);
@@ -195,50 +813,67 @@ namespace UQPack {
         // Convert encoding flags to hex digit (0-F)
         char encodingHex = (encodingFlags < 10) ? ('0' + encodingFlags) : ('A' + encodingFlags - 10);
         header.push_back(encodingHex);
+
+        // Dictionary id as uppercase hex without leading zeros
+        if (options.dictionaryId != 0) {
+            char idHex[9];
+            std::snprintf(idHex, sizeof(idHex), "%X", static_cast<unsigned>(options.dictionaryId));
+            header += idHex;
+        }
         
         // Final format: header + ":" + encoded data + ":" + checksumStr
         std::string finalStr = header + ":" + encoded + ":" + checksumStr;
         return finalStr;
     }
     
-    // Encode JSON data with compression type
-    std::string encode(const json& jsonData, CompressionType compressionType, int baseIndex) {
+    // Encode JSON data with explicit options
+    std::string encode(const json& jsonData, const EncodeOptions& options) {
+        return Encoder::local().encode(jsonData, options);
+    }
+
+    std::string Encoder::encode(const std::vector<std::uint8_t>& data, const EncodeOptions& options) {
+        return UQPack::encode(data, options);
+    }
+
+    std::string encode(const json& jsonData, const EncodeOptions& options, CodecSelection& selection) {
+        return Encoder::local().encode(jsonData, options, selection);
+    }
+
+    std::string Encoder::encode(const json& jsonData, const EncodeOptions& options) {
+        CodecSelection selection;
+        return encode(jsonData, options, selection);
+    }
+
+    std::string Encoder::encode(const json& jsonData, const EncodeOptions& options, CodecSelection& selection) {
         // Convert the JSON to MessagePack or string format
         std::vector<uint8_t> serializedData = json::to_msgpack(jsonData);
         
-        // Process the data (compress if needed)
+        // Process the data (compress if needed; AUTO and the tuner pick the codec here)
+        EncodeOptions resolved = options;
         std::vector<std::uint8_t> processedData;
-        if (compressionType != CompressionType::NONE) {
-            // Compress the data using the specified compression method
-            processedData = compressData(
-                serializedData.data(),
-                serializedData.size(),
-                compressionType
-            );
-            
-            std::cout << "Compressed size: " << processedData.size() << " bytes (from " 
-                      << serializedData.size() << " bytes) using ";
-            
-            switch (compressionType) {
-                case CompressionType::LZ4: std::cout << "LZ4"; break;
-                case CompressionType::ZSTD: std::cout << "Zstd"; break;
-                case CompressionType::BROTLI: std::cout << "Brotli"; break;
-                default: std::cout << "Unknown"; break;
-            }
-            
-            std::cout << std::endl;
+        if (options.tuner) {
+            CompressionTuner::Decision decision = options.tuner->choose(jsonData, resolved);
+            auto start = std::chrono::steady_clock::now();
+            processedData = compress(serializedData.data(), serializedData.size(), resolved, selection);
+            options.tuner->record(decision, std::chrono::steady_clock::now() - start, serializedData.size(), processedData.size());
         } else {
-            // Use the original data without compression
-            processedData = std::vector<std::uint8_t>(serializedData.begin(), serializedData.end());
+            processedData = compress(serializedData.data(), serializedData.size(), options, selection);
         }
-        
-        // Auto-select baseIndex if not specified
-        if (baseIndex < 0) {
-            std::string jsonStr = jsonData.dump();
-            baseIndex = calculateBaseIndex(jsonStr);
+        const CompressionType compressionType = selection.compressionType;
+        resolved.compressionType = compressionType;
+        resolved.framedBlocks = selection.framed;
+        if (compressionType == CompressionType::NONE) {
+            // AUTO found compression not worth it; the dictionary went with it
+            resolved.dictionaryId = 0;
         }
-        
+
+        // Auto-select baseIndex if not specified, from the compressed length alone
+        if (resolved.baseIndex < 0) {
+            resolved.baseIndex = selectBaseIndex(processedData, resolved).baseIndex;
+        }
+        selection.baseIndex = resolved.baseIndex;
+
         // Encode the processed data
-        return encode(processedData, compressionType, baseIndex);
+        return UQPack::encode(processedData, resolved);
     }
 }
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include <stream.hpp>
+#include <base.hpp>
+#include <common.hpp>
+#include <cstring>
+#include <stdexcept>
+#include <brotli/decode.h>
+
+#ifndef EMSCRIPTEN
+#include <zstd.h>
+#endif
+
+namespace UQPack {
+    namespace {
+        // Digits are converted once this many whole blocks are pending
+        constexpr size_t streamBlockBatch = 4096;
+
+        // Longest checksum accepted after the last ':'
+        constexpr size_t maxChecksumLength = 16;
+
+        int fromHexDigit(char c) {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            } else if (c >= 'A' && c <= 'F') {
+                return c - 'A' + 10;
+            } else if (c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            return -1;
+        }
+    }
+
+    struct StreamDecoder::State {
+        enum class Phase { HEADER, DIGITS, CHECKSUM };
+
+        ByteSink sink;
+        Phase phase = Phase::HEADER;
+        std::string header;
+        std::string digits;    // digits not yet converted
+        std::string checksumStr;
+        ChecksumStream checksum;
+
+        CompressionType compressionType = CompressionType::NONE;
+        const std::string* charset = nullptr;
+        unsigned fullDigits = 0;
+
+        #ifndef EMSCRIPTEN
+        ZSTD_DCtx* zstd = nullptr;
+        bool zstdFrameDone = false;
+        #endif
+        BrotliDecoderState* brotli = nullptr;
+        BrotliDecoderResult brotliResult = BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT;
+        bool brotliSizePending = false; // original size prefix (encode() tokens) not yet skipped
+        std::vector<std::uint8_t> decompressed; // decompressor output scratch
+
+        explicit State(ByteSink sink) : sink(std::move(sink)), decompressed(64 * 1024) {}
+
+        ~State() {
+            #ifndef EMSCRIPTEN
+            ZSTD_freeDCtx(zstd);
+            #endif
+            if (brotli) {
+                BrotliDecoderDestroyInstance(brotli);
+            }
+        }
+
+        void parseHeader() {
+            if (header.length() != 4 || header.substr(0, 2) != "PX") {
+                throw std::runtime_error("Invalid header format");
+            }
+            const int compressionFlags = fromHexDigit(header[2]);
+            const int encodingFlags = fromHexDigit(header[3]);
+            if (compressionFlags < 0) {
+                throw std::runtime_error("Invalid compression flag format");
+            }
+            if (encodingFlags < 0) {
+                throw std::runtime_error("Invalid encoding flag format");
+            }
+            if ((encodingFlags & 0x8) == 0) {
+                throw std::runtime_error("Streaming decode requires a block-encoded token");
+            }
+            if (encodingFlags & 0x4) {
+                throw std::runtime_error("Framed block compression not supported in streaming mode");
+            }
+
+            charset = &basesCharSet[(encodingFlags & 0x1) ? 1 : 0];
+            fullDigits = internal::blockDigits(static_cast<unsigned>(charset->length()), internal::blockBytes);
+
+            switch (compressionFlags) {
+                case 0x0:
+                    compressionType = CompressionType::NONE;
+                    break;
+                case 0x2:
+                    #ifndef EMSCRIPTEN
+                    compressionType = CompressionType::ZSTD;
+                    zstd = ZSTD_createDCtx();
+                    if (!zstd) {
+                        throw std::runtime_error("Failed to create Zstd decompression context");
+                    }
+                    break;
+                    #else
+                    throw std::runtime_error("Zstd compression not supported on this platform");
+                    #endif
+                case 0x4:
+                    compressionType = CompressionType::BROTLI;
+                    brotli = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+                    if (!brotli) {
+                        throw std::runtime_error("Failed to create Brotli decoder instance");
+                    }
+                    brotliSizePending = (encodingFlags & 0x2) != 0;
+                    break;
+                default:
+                    throw std::runtime_error("Compression type not supported in streaming mode");
+            }
+        }
+
+        void decompress(const std::uint8_t* data, size_t size) {
+            switch (compressionType) {
+                case CompressionType::NONE:
+                    sink(data, size);
+                    return;
+
+                #ifndef EMSCRIPTEN
+                case CompressionType::ZSTD: {
+                    ZSTD_inBuffer input = {data, size, 0};
+                    while (input.pos < input.size) {
+                        if (zstdFrameDone) {
+                            throw std::runtime_error("Trailing data after Zstd frame");
+                        }
+                        ZSTD_outBuffer output = {decompressed.data(), decompressed.size(), 0};
+                        size_t result = ZSTD_decompressStream(zstd, &output, &input);
+                        if (ZSTD_isError(result)) {
+                            throw std::runtime_error("Zstd decompression failed: " + std::string(ZSTD_getErrorName(result)));
+                        }
+                        zstdFrameDone = (result == 0);
+                        sink(decompressed.data(), output.pos);
+                    }
+                    return;
+                }
+                #endif
+
+                case CompressionType::BROTLI: {
+                    size_t availableIn = size;
+                    const uint8_t* nextIn = data;
+                    // The size prefix is a varint: its last byte has the top bit clear
+                    while (brotliSizePending && availableIn > 0) {
+                        brotliSizePending = (*nextIn & 0x80) != 0;
+                        nextIn++;
+                        availableIn--;
+                    }
+                    if (availableIn == 0) {
+                        return;
+                    }
+                    do {
+                        size_t availableOut = decompressed.size();
+                        uint8_t* nextOut = decompressed.data();
+                        brotliResult = BrotliDecoderDecompressStream(brotli, &availableIn, &nextIn, &availableOut, &nextOut, nullptr);
+                        if (brotliResult == BROTLI_DECODER_RESULT_ERROR) {
+                            throw std::runtime_error("Brotli decompression failed");
+                        }
+                        sink(decompressed.data(), decompressed.size() - availableOut);
+                    } while (brotliResult == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+                    if (brotliResult == BROTLI_DECODER_RESULT_SUCCESS && availableIn > 0) {
+                        throw std::runtime_error("Trailing data after Brotli stream");
+                    }
+                    return;
+                }
+
+                default:
+                    throw std::runtime_error("Compression type not supported in streaming mode");
+            }
+        }
+
+        // Convert whole blocks of pending digits; the final partial block only at the end
+        void convert(bool last) {
+            size_t ready = last ? digits.size() : digits.size() - digits.size() % fullDigits;
+            if (ready == 0 || (!last && ready < streamBlockBatch * fullDigits)) {
+                return;
+            }
+            std::vector<std::uint8_t> bytes = convertFromBaseBlocks(digits.substr(0, ready), *charset);
+            digits.erase(0, ready);
+            decompress(bytes.data(), bytes.size());
+        }
+
+        void write(const char* data, size_t size) {
+            while (size > 0) {
+                switch (phase) {
+                    case Phase::HEADER: {
+                        const char* colon = static_cast<const char*>(std::memchr(data, ':', size));
+                        size_t take = colon ? static_cast<size_t>(colon - data) : size;
+                        header.append(data, take);
+                        if (header.size() > 4) {
+                            throw std::runtime_error("Invalid header format");
+                        }
+                        if (colon) {
+                            parseHeader();
+                            phase = Phase::DIGITS;
+                            take++;
+                        }
+                        data += take;
+                        size -= take;
+                        break;
+                    }
+
+                    case Phase::DIGITS: {
+                        const char* colon = static_cast<const char*>(std::memchr(data, ':', size));
+                        size_t take = colon ? static_cast<size_t>(colon - data) : size;
+                        if (!internal::isValidDigits(data, take, internal::digitTable(*charset))) {
+                            throw std::runtime_error("Invalid character in encoded data");
+                        }
+                        checksum.update(data, take);
+                        digits.append(data, take);
+                        convert(colon != nullptr);
+                        if (colon) {
+                            phase = Phase::CHECKSUM;
+                            take++;
+                        }
+                        data += take;
+                        size -= take;
+                        break;
+                    }
+
+                    case Phase::CHECKSUM:
+                        checksumStr.append(data, size);
+                        if (checksumStr.size() > maxChecksumLength) {
+                            throw std::runtime_error("Invalid encoded string format");
+                        }
+                        size = 0;
+                        break;
+                }
+            }
+        }
+    };
+
+    StreamDecoder::StreamDecoder(ByteSink sink) : state(new State(std::move(sink))) {}
+
+    StreamDecoder::~StreamDecoder() = default;
+
+    void StreamDecoder::write(const char* data, size_t size) {
+        state->write(data, size);
+    }
+
+    void StreamDecoder::finish() {
+        if (state->phase != State::Phase::CHECKSUM) {
+            throw std::runtime_error("Invalid encoded string format");
+        }
+
+        std::string computedChecksumStr = state->checksum.finish();
+        if (state->checksumStr != computedChecksumStr) {
+            throw std::runtime_error("Checksum validation failed. Supposed to be " + computedChecksumStr + " but got " + state->checksumStr);
+        }
+
+        #ifndef EMSCRIPTEN
+        if (state->compressionType == CompressionType::ZSTD && !state->zstdFrameDone) {
+            throw std::runtime_error("Zstd decompression failed: truncated frame");
+        }
+        #endif
+        if (state->compressionType == CompressionType::BROTLI && state->brotliResult != BROTLI_DECODER_RESULT_SUCCESS) {
+            throw std::runtime_error("Brotli decompression failed");
+        }
+    }
+}
@@ -0,0 +1,191 @@
+#include <stream.hpp>
+#include <base.hpp>
+#include <common.hpp>
+#include <stdexcept>
+#include <zstd.h>
+#include <brotli/encode.h>
+
+namespace UQPack {
+    namespace {
+        // Compressed bytes are converted once this many whole blocks are pending
+        constexpr size_t streamBlockBatch = 4096;
+
+        char toHexDigit(int value) {
+            return (value < 10) ? ('0' + value) : ('A' + value - 10);
+        }
+
+        // Checked before State indexes basesCharSet with it. Block mode exists for Base64
+        // and Base70 only; Base45 tokens are not streamed, and there is no automatic
+        // selection since the payload size is not known up front.
+        int streamBaseIndex(int baseIndex) {
+            if (baseIndex != 0 && baseIndex != 1) {
+                throw std::runtime_error("Streaming encode supports baseIndex 0 or 1");
+            }
+            return baseIndex;
+        }
+    }
+
+    struct StreamEncoder::State {
+        CharSink sink;
+        CompressionType compressionType;
+        int baseIndex;
+        const std::string& charset;
+        ChecksumStream checksum;
+
+        ZSTD_CCtx* zstd = nullptr;
+        BrotliEncoderState* brotli = nullptr;
+        std::vector<std::uint8_t> compressed;  // compressor output scratch
+        std::vector<std::uint8_t> pending;     // compressed bytes not yet converted
+        bool started = false;
+        bool finished = false;
+
+        State(CharSink sink, CompressionType compressionType, int baseIndex)
+            : sink(std::move(sink)), compressionType(compressionType), baseIndex(baseIndex), charset(basesCharSet[baseIndex]) {}
+
+        ~State() {
+            ZSTD_freeCCtx(zstd);
+            if (brotli) {
+                BrotliEncoderDestroyInstance(brotli);
+            }
+        }
+
+        // Same header as encode() with the block conversion bit set
+        void start() {
+            if (started) {
+                return;
+            }
+            started = true;
+
+            int compressionFlags = 0;
+            switch (compressionType) {
+                case CompressionType::ZSTD:
+                    compressionFlags = 0x2;
+                    break;
+                case CompressionType::BROTLI:
+                    compressionFlags = 0x4;
+                    break;
+                default:
+                    break;
+            }
+            int encodingFlags = 0x8 | (baseIndex == 1 ? 0x1 : 0x0);
+
+            std::string header = "PX";
+            header.push_back(toHexDigit(compressionFlags));
+            header.push_back(toHexDigit(encodingFlags));
+            header.push_back(':');
+            sink(header.data(), header.size());
+        }
+
+        // Convert whole blocks (or everything, at the end) and pass the digits on
+        void emit(const std::uint8_t* data, size_t size, bool last) {
+            pending.insert(pending.end(), data, data + size);
+            size_t ready = last ? pending.size() : pending.size() - pending.size() % internal::blockBytes;
+            if (ready == 0 || (!last && ready < streamBlockBatch * internal::blockBytes)) {
+                return;
+            }
+
+            std::vector<std::uint8_t> blocks(pending.begin(), pending.begin() + ready);
+            pending.erase(pending.begin(), pending.begin() + ready);
+            std::string digits = convertToBaseBlocks(blocks, charset);
+            checksum.update(digits.data(), digits.size());
+            sink(digits.data(), digits.size());
+        }
+
+        void compress(const std::uint8_t* data, size_t size, bool last) {
+            switch (compressionType) {
+                case CompressionType::NONE:
+                    emit(data, size, last);
+                    return;
+
+                case CompressionType::ZSTD: {
+                    ZSTD_inBuffer input = {data, size, 0};
+                    size_t remaining;
+                    do {
+                        ZSTD_outBuffer output = {compressed.data(), compressed.size(), 0};
+                        remaining = ZSTD_compressStream2(zstd, &output, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+                        if (ZSTD_isError(remaining)) {
+                            throw std::runtime_error("Zstd compression failed: " + std::string(ZSTD_getErrorName(remaining)));
+                        }
+                        emit(compressed.data(), output.pos, false);
+                    } while (last ? remaining != 0 : input.pos < input.size);
+                    if (last) {
+                        emit(nullptr, 0, true);
+                    }
+                    return;
+                }
+
+                case CompressionType::BROTLI: {
+                    size_t availableIn = size;
+                    const uint8_t* nextIn = data;
+                    const BrotliEncoderOperation operation = last ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+                    do {
+                        size_t availableOut = compressed.size();
+                        uint8_t* nextOut = compressed.data();
+                        if (!BrotliEncoderCompressStream(brotli, operation, &availableIn, &nextIn, &availableOut, &nextOut, nullptr)) {
+                            throw std::runtime_error("Brotli compression failed");
+                        }
+                        emit(compressed.data(), compressed.size() - availableOut, false);
+                    } while (availableIn > 0 || BrotliEncoderHasMoreOutput(brotli) ||
+                             (last && !BrotliEncoderIsFinished(brotli)));
+                    if (last) {
+                        emit(nullptr, 0, true);
+                    }
+                    return;
+                }
+
+                default:
+                    throw std::runtime_error("Compression type not supported in streaming mode");
+            }
+        }
+    };
+
+    StreamEncoder::StreamEncoder(CharSink sink, CompressionType compressionType, int baseIndex)
+        : state(new State(std::move(sink), compressionType, streamBaseIndex(baseIndex))) {
+        switch (compressionType) {
+            case CompressionType::NONE:
+                break;
+            case CompressionType::ZSTD:
+                state->zstd = ZSTD_createCCtx();
+                if (!state->zstd) {
+                    throw std::runtime_error("Failed to create Zstd compression context");
+                }
+                // Same level as compressWithZstd
+                ZSTD_CCtx_setParameter(state->zstd, ZSTD_c_compressionLevel, 1);
+                state->compressed.resize(ZSTD_CStreamOutSize());
+                break;
+            case CompressionType::BROTLI:
+                state->brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+                if (!state->brotli) {
+                    throw std::runtime_error("Failed to create Brotli encoder instance");
+                }
+                // Same quality as compressData
+                BrotliEncoderSetParameter(state->brotli, BROTLI_PARAM_QUALITY, 11);
+                state->compressed.resize(64 * 1024);
+                break;
+            default:
+                throw std::runtime_error("Compression type not supported in streaming mode");
+        }
+    }
+
+    StreamEncoder::~StreamEncoder() = default;
+
+    void StreamEncoder::write(const std::uint8_t* data, size_t size) {
+        if (state->finished) {
+            throw std::runtime_error("StreamEncoder already finished");
+        }
+        state->start();
+        state->compress(data, size, false);
+    }
+
+    void StreamEncoder::finish() {
+        if (state->finished) {
+            throw std::runtime_error("StreamEncoder already finished");
+        }
+        state->start();
+        state->compress(nullptr, 0, true);
+        state->finished = true;
+
+        std::string trailer = ":" + state->checksum.finish();
+        state->sink(trailer.data(), trailer.size());
+    }
+}
@@ -0,0 +1,190 @@
+#include <tuner.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace UQPack {
+    namespace {
+        // Weight of the newest document in the running means
+        constexpr double smoothing = 0.05;
+
+        // Shape that documents share once maxShapes distinct ones are tracked
+        constexpr std::uint64_t otherShapes = 0;
+
+        // A stronger rung has to compress at least this much better to be worth its time
+        constexpr double minRatioGain = 1.01;
+
+        // FNV-1a, enough to tell key sets apart
+        std::uint64_t fnv1a(std::uint64_t hash, const std::string& text) {
+            for (unsigned char c : text) {
+                hash = (hash ^ c) * 0x100000001B3ULL;
+            }
+            return (hash ^ 0xFF) * 0x100000001B3ULL; // terminator, so "ab","c" != "a","bc"
+        }
+    }
+
+    CompressionTuner::CompressionTuner(TunerOptions tunerOptions) : options(std::move(tunerOptions)) {
+        if (options.ladder.empty() || options.initialRung >= options.ladder.size()) {
+            throw std::runtime_error("Tuner ladder must contain the initial rung");
+        }
+        options.window = std::max<size_t>(options.window, 1);
+        options.minSamples = std::max<size_t>(options.minSamples, 1);
+    }
+
+    std::uint64_t CompressionTuner::shapeOf(const json& document) {
+        std::uint64_t hash = 0xCBF29CE484222325ULL;
+        if (!document.is_object()) {
+            return fnv1a(hash, document.type_name());
+        }
+        // Objects iterate in key order, so the fingerprint ignores member order
+        for (auto it = document.begin(); it != document.end(); ++it) {
+            hash = fnv1a(hash, it.key());
+        }
+        return hash;
+    }
+
+    CompressionTuner::Shape& CompressionTuner::shape(std::uint64_t fingerprint) {
+        auto it = shapes.find(fingerprint);
+        if (it == shapes.end()) {
+            if (shapes.size() >= options.maxShapes) {
+                fingerprint = otherShapes;
+                it = shapes.find(fingerprint);
+            }
+            if (it == shapes.end()) {
+                Shape fresh;
+                fresh.rung = options.initialRung;
+                fresh.rungs.resize(options.ladder.size());
+                it = shapes.emplace(fingerprint, std::move(fresh)).first;
+            }
+        }
+        return it->second;
+    }
+
+    void CompressionTuner::move(Shape& shape, size_t rung) {
+        shape.rung = rung;
+        shape.recent.clear();
+        shape.next = 0;
+        shape.samples = 0;
+    }
+
+    CompressionTuner::Decision CompressionTuner::choose(const json& document, EncodeOptions& encodeOptions) {
+        Decision decision;
+        decision.shape = shapeOf(document);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Shape& entry = shape(decision.shape);
+            decision.rung = entry.rung;
+            if (shapes.find(decision.shape) == shapes.end()) {
+                decision.shape = otherShapes;
+            }
+        }
+
+        const TunerRung& rung = options.ladder[decision.rung];
+        encodeOptions.compressionType = rung.compressionType;
+        switch (rung.compressionType) {
+            case CompressionType::LZ4:
+                encodeOptions.lz4Acceleration = rung.level;
+                break;
+            case CompressionType::LZ4HC:
+                encodeOptions.lz4hcLevel = rung.level;
+                break;
+            case CompressionType::DEFLATE:
+                encodeOptions.deflateLevel = rung.level;
+                break;
+            case CompressionType::ZSTD:
+                encodeOptions.zstdLevel = rung.level;
+                break;
+            case CompressionType::BROTLI:
+                encodeOptions.brotliQuality = rung.level;
+                break;
+            default:
+                break;
+        }
+        if (rung.compressionType == CompressionType::NONE || rung.compressionType == CompressionType::DEFLATE) {
+            // Neither takes a dictionary
+            encodeOptions.dictionaryId = 0;
+        }
+        return decision;
+    }
+
+    void CompressionTuner::record(const Decision& decision, std::chrono::nanoseconds elapsed, size_t inputSize, size_t compressedSize) {
+        const double micros = std::chrono::duration<double, std::micro>(elapsed).count();
+        const double ratio = compressedSize > 0 ? static_cast<double>(inputSize) / compressedSize : 1.0;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Shape& entry = shape(decision.shape);
+        entry.documents++;
+
+        RungStats& used = entry.rungs[decision.rung];
+        used.documents++;
+        const double weight = used.documents == 1 ? 1.0 : smoothing;
+        used.meanMicros += weight * (micros - used.meanMicros);
+        used.ratio += weight * (ratio - used.ratio);
+
+        // Another thread moved the shape since this document was decided
+        if (decision.rung != entry.rung) {
+            return;
+        }
+
+        if (entry.recent.size() < options.window) {
+            entry.recent.push_back(micros);
+        } else {
+            entry.recent[entry.next] = micros;
+            entry.next = (entry.next + 1) % options.window;
+        }
+        if (++entry.samples < options.minSamples || entry.samples % options.minSamples != 0) {
+            return;
+        }
+
+        // Decide every minSamples documents, on the recent times of this rung only
+        std::vector<double> times = entry.recent;
+        const size_t rank = std::min(times.size() - 1, static_cast<size_t>(options.percentile * times.size()));
+        std::nth_element(times.begin(), times.begin() + rank, times.end());
+        used.percentileMicros = times[rank];
+
+        const double budget = std::chrono::duration<double, std::micro>(options.latencyBudget).count();
+        if (used.percentileMicros > budget && entry.rung > 0) {
+            used.blockedUntil = entry.documents + options.cooldown;
+            move(entry, entry.rung - 1);
+        } else if (used.percentileMicros < options.raiseBelow * budget && entry.rung + 1 < options.ladder.size()) {
+            const RungStats& stronger = entry.rungs[entry.rung + 1];
+            const bool allowed = stronger.blockedUntil <= entry.documents;
+            const bool better = stronger.documents == 0 || stronger.ratio > used.ratio * minRatioGain;
+            if (allowed && better) {
+                move(entry, entry.rung + 1);
+            }
+        }
+    }
+
+    json CompressionTuner::stats() const {
+        static const char* const codecNames[] = {"none", "lz4", "zstd", "brotli", "auto", "lz4hc", "deflate"};
+
+        std::lock_guard<std::mutex> lock(mutex);
+        json result = json::array();
+        for (const auto& [fingerprint, entry] : shapes) {
+            json rungs = json::array();
+            for (size_t i = 0; i < entry.rungs.size(); i++) {
+                const RungStats& rung = entry.rungs[i];
+                if (rung.documents == 0) {
+                    continue;
+                }
+                rungs.push_back({
+                    {"codec", codecNames[static_cast<int>(options.ladder[i].compressionType)]},
+                    {"level", options.ladder[i].level},
+                    {"documents", rung.documents},
+                    {"meanMicros", rung.meanMicros},
+                    {"percentileMicros", rung.percentileMicros},
+                    {"ratio", rung.ratio}
+                });
+            }
+            const TunerRung& current = options.ladder[entry.rung];
+            result.push_back({
+                {"shape", fingerprint},
+                {"documents", entry.documents},
+                {"codec", codecNames[static_cast<int>(current.compressionType)]},
+                {"level", current.level},
+                {"rungs", std::move(rungs)}
+            });
+        }
+        return result;
+    }
+}
@@ -0,0 +1,309 @@
+#include <encode.hpp>
+#include <decode.hpp>
+#include <common.hpp>
+#include <stream.hpp>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Wire format regression test: round-trips payloads through every token variant the
+// header can describe, decodes tokens made by earlier versions (which must keep
+// decoding), and checks that malformed payloads are rejected before anything is
+// allocated for them. A change to the token format that breaks old tokens fails here.
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const std::string& what) {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            failures++;
+        }
+    }
+
+    template<typename F>
+    void checkThrows(F&& f, const std::string& what) {
+        try {
+            f();
+        } catch (const std::exception&) {
+            return;
+        }
+        std::cerr << "FAILED: " << what << " was accepted" << std::endl;
+        failures++;
+    }
+
+    // The payload the stored tokens below were made from
+    std::vector<std::uint8_t> sample() {
+        std::string text;
+        for (int i = 0; i < 12; i++) {
+            text += "{\"sku\":\"SKU-" + std::to_string(10000 + 37 * i) + "\",\"qty\":" + std::to_string(1 + i % 3) + "}";
+        }
+        return std::vector<std::uint8_t>(text.begin(), text.end());
+    }
+
+    int hexDigit(char c) {
+        return c <= '9' ? c - '0' : c - 'A' + 10;
+    }
+
+    // Compress and encode data as encode(json) does, and check that it decodes back
+    std::string roundTrip(const std::vector<std::uint8_t>& data, UQPack::EncodeOptions options, const std::string& what) {
+        UQPack::Encoder encoder;
+        UQPack::CodecSelection selection;
+        const std::vector<std::uint8_t> compressed = encoder.compress(data.data(), data.size(), options, selection);
+        options.framedBlocks = selection.framed;
+        const std::string token = encoder.encode(compressed, options);
+
+        UQPack::CompressionType compressionType;
+        check(UQPack::decodeInternal(token, compressionType) == data, what + ": round trip");
+        std::vector<std::uint8_t> buffer(data.size());
+        UQPack::DecodeResult result = UQPack::decodeInto(token, buffer.data(), buffer.size());
+        check(result.fits && result.size == data.size() && buffer == data, what + ": decodeInto");
+        return token;
+    }
+
+    // Token carrying bytes as the payload of the given codec, without compressing them
+    std::string forge(const std::vector<std::uint8_t>& bytes, UQPack::CompressionType compressionType, bool framed) {
+        UQPack::EncodeOptions options;
+        options.compressionType = compressionType;
+        options.baseIndex = 0;
+        options.framedBlocks = framed;
+        return UQPack::encode(bytes, options);
+    }
+
+    // Token with its header replaced, for flag combinations encode() does not produce;
+    // the checksum covers the digits only
+    std::string withHeader(const std::string& token, const std::string& header) {
+        return header + token.substr(token.find(':'));
+    }
+
+    std::vector<std::uint8_t> frameHeader(std::uint32_t blockSize, std::uint32_t originalSize, const std::vector<std::uint32_t>& blockBytes) {
+        std::vector<std::uint8_t> frame(9 + 4 * blockBytes.size());
+        frame[0] = 1;
+        UQPack::internal::storeSize32(frame.data() + 1, blockSize);
+        UQPack::internal::storeSize32(frame.data() + 5, originalSize);
+        for (size_t i = 0; i < blockBytes.size(); i++) {
+            UQPack::internal::storeSize32(frame.data() + 9 + 4 * i, blockBytes[i]);
+        }
+        return frame;
+    }
+
+    void checkDecodeFails(const std::string& token, const std::string& what) {
+        UQPack::CompressionType compressionType;
+        checkThrows([&] { UQPack::decodeInternal(token, compressionType); }, what);
+        // Reporting the size needed must not trust the claim either
+        checkThrows([&] { UQPack::decodeInto(token, nullptr, 0); }, what + " (size query)");
+    }
+
+    // Encoding bit 0x4: frames of independently compressed blocks
+    void blockFrames() {
+        const std::vector<std::uint8_t> data = sample();
+        for (UQPack::CompressionType type : {UQPack::CompressionType::LZ4, UQPack::CompressionType::ZSTD, UQPack::CompressionType::BROTLI}) {
+            for (int baseIndex : {0, 1}) {
+                UQPack::EncodeOptions options;
+                options.compressionType = type;
+                options.baseIndex = baseIndex;
+                options.compressionBlockSize = 128;
+                const std::string what = "frame codec " + std::to_string(static_cast<int>(type)) + " base " + std::to_string(baseIndex);
+                const std::string token = roundTrip(data, options, what);
+                check((hexDigit(token[3]) & 0x4) != 0, what + ": framed flag");
+            }
+        }
+
+        // Framed tokens made before Brotli payloads had a size prefix
+        const char* const stored[] = {
+            "PX14:YAAAABEAQAARQAAAEgAAAA5AAAAgAAAAPsMeyJza3UiOiJTS1UtMTAwMDAiLCJxdHkiOjF9GwAkMzcbABwyGwAkNzQbABszGwA0MTExGwAMUQBgMTQ4IiwigAAAAPEMcXR5IjoyfXsic2t1IjoiU0tVLTEwMTg1IiwiGwAbMxsANDIyMhsAHDEbACQ1ORsADFEANDI5NhsABlEAUFNLVS0xRAAAAPQQMDMzMyIsInF0eSI6MX17InNrdSI6IlNLVS0xMDM3MBsAGzIbANA0MDciLCJxdHkiOjN9:F8",
+            "PX24:YAAAABEAQAARgAAAEcAAAA_AAAAKLUv_SCA7QEApAJ7InNrdSI6IlNLVS0xMDAwMCIsInF0eSI6MX0zNzI3NDMxMTExNDgiLCIHAAAJQAzoFxAIEANE27uJByi1L_0ggPUBALQCcXR5IjoyfXsic2t1IjoiU0tVLTEwMTg1IiwicXR5IjozMjIyMTU5Mjk2MwcAQArwIkAMEA0gAYgR7-YTKLUv_SBEtQEA1AIwMzMzIiwicXR5IjoxfXsic2t1IjoiU0tVLTEwMzcwMjQwNyIsInF0eSI6M30CAKCLnZhO:Bz",
+            "PX44:BgAAAAEQBAABBAAAARAAAAD8AAAAbfwD4Hacr-oKHsRJBuS31yxP-3UBjt2oQMafi5lJnqQo24MTCEALCBfFQ4enxOkA3SxJB-8KfHNkZVant9GoSABt_APitCsxz3cm42F4yiJt9uTApWrbE7YGbLHWyhTOc1tRc6ixVpUhdXsOs0fVpJSzwYKOhwlPDa0gzvmqkDKDrk34RG0MA-K2Kd4DtUDN14mneR1YNh1QwfeA2vH7vAm2BORU3lzprdClSl5dLVXvtgRKSeCRUuACNenIXog1qO96N:Ih",
+            "PX45:z5KPOjzp1qQncZhfPsDGLAJko1KhX1F4KhjvHmnN2E-FjL_n~4aWoTzZFkdZtrUFk9JWriPo5kWkE9_XdQJ.B0HyYt8CuILmHrRuyDe7aIUKhc3RLsxF7~ISdYoAFso6e9cEoLn0Novnk0ZJJWjByWCulLmLMNecr7d5S6jfF-PIdALLqVQJHkCGwiruMbfN0Sw8K32sRRb1r3R~2hjI79ZCX1xOLx25CJ5OVTidDpSQZRi1zRPVdvxCv7Ffh-EnDA_.fSpT978yL~sRlkL1WavvTgyPdx:DB",
+        };
+        for (const char* token : stored) {
+            UQPack::CompressionType compressionType;
+            check(UQPack::decodeInternal(token, compressionType) == data, std::string("stored frame ") + std::string(token, 4));
+        }
+
+        // Original size of 1 GiB claimed by a 30-character token
+        checkDecodeFails("PX24:EAAABAAAAAQAQAAAAotS_9:MN", "frame claiming 1 GiB");
+
+        // An LZ4 block claiming the whole 1 GiB the frame claims
+        std::vector<std::uint8_t> frame = frameHeader(1u << 30, 1u << 30, {8});
+        const std::uint8_t hugeBlock[8] = {0, 0, 0, 0x40, 0x10, 'x', 0, 0};
+        frame.insert(frame.end(), hugeBlock, hugeBlock + 8);
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "LZ4 block claiming 1 GiB");
+
+        // Blocks made from the sample, framed with sizes that do not match them
+        UQPack::Encoder encoder;
+        const std::vector<std::uint8_t> block = encoder.compress(data.data(), 100, UQPack::CompressionType::LZ4);
+        const std::uint32_t blockBytes = static_cast<std::uint32_t>(block.size());
+
+        frame = frameHeader(100, 100, {blockBytes});
+        frame.insert(frame.end(), block.begin(), block.end());
+        UQPack::CompressionType compressionType;
+        check(UQPack::decodeInternal(forge(frame, UQPack::CompressionType::LZ4, true), compressionType) == std::vector<std::uint8_t>(data.begin(), data.begin() + 100),
+              "hand-made frame");
+
+        frame.push_back(0);
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "frame with bytes after its last block");
+
+        frame = frameHeader(200, 200, {blockBytes});
+        frame.insert(frame.end(), block.begin(), block.end());
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "block of the wrong size");
+
+        frame = frameHeader(100, 200, {blockBytes});
+        frame.insert(frame.end(), block.begin(), block.end());
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "truncated block table");
+
+        frame = frameHeader(100, 100, {blockBytes + 1});
+        frame.insert(frame.end(), block.begin(), block.end());
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "truncated block");
+
+        frame = frameHeader(0, 100, {});
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "zero block size");
+
+        frame = frameHeader(100, 100, {blockBytes});
+        frame[0] = 2;
+        frame.insert(frame.end(), block.begin(), block.end());
+        checkDecodeFails(forge(frame, UQPack::CompressionType::LZ4, true), "unknown frame version");
+
+        checkDecodeFails(withHeader(forge(data, UQPack::CompressionType::NONE, false), "PX04"), "framed token without compression");
+    }
+
+    // Encoding bit 0x2: Brotli payloads start with their original size
+    void brotliSizePrefix() {
+        const std::vector<std::uint8_t> data = sample();
+        for (UQPack::EncodingMode mode : {UQPack::EncodingMode::INTEGER, UQPack::EncodingMode::BLOCK}) {
+            for (int baseIndex : {0, 1, 2}) {
+                UQPack::EncodeOptions options;
+                options.compressionType = UQPack::CompressionType::BROTLI;
+                options.baseIndex = baseIndex;
+                options.encodingMode = mode;
+                const std::string what = "Brotli base " + std::to_string(baseIndex) + " mode " + std::to_string(static_cast<int>(mode));
+                const std::string token = roundTrip(data, options, what);
+                check((hexDigit(token[3]) & 0x2) != 0, what + ": size prefix flag");
+            }
+        }
+
+        // Streamed tokens have no prefix and leave the bit clear
+        std::string streamed;
+        UQPack::StreamEncoder stream([&](const char* digits, size_t size) { streamed.append(digits, size); }, UQPack::CompressionType::BROTLI, 0);
+        stream.write(data);
+        stream.finish();
+        UQPack::CompressionType compressionType;
+        check((hexDigit(streamed[3]) & 0x2) == 0, "streamed Brotli: no size prefix flag");
+        check(UQPack::decodeInternal(streamed, compressionType) == data, "streamed Brotli: round trip");
+
+        // Tokens made before the prefix existed
+        const char* const stored[] = {
+            "PX40:BtDAfitineA7VBTMaPehUdVwyOlTsueG9v67gaAhuZU3FyK1OU1zFJVn1qjQxVOrDiECNCB-aVCJp-2KBYBUK86XA5VWh5Jsl6qHXmSyOao7suzTRZIp5EB:H7",
+            "PX41:2.dL7I7D79IeQcv4pzRSTBbAuNGM9s9Q9rKHNssIZ2Io1G.cG4IDCBHdlLX2LGaZrWqOisb10uuyXP5K4ADAsVFz4mbGn9Yd6XuRhF7OH4nff~1mXgx737:KJ",
+        };
+        for (const char* token : stored) {
+            check(UQPack::decodeInternal(token, compressionType) == data, std::string("stored unprefixed Brotli ") + std::string(token, 4));
+        }
+
+        UQPack::Encoder encoder;
+        std::vector<std::uint8_t> prefixed = encoder.compressWithBrotli(data.data(), data.size());
+        size_t streamStart = 0;
+        std::uint64_t recorded;
+        check(UQPack::internal::readVarint(prefixed.data(), prefixed.size(), streamStart, recorded) && recorded == data.size(), "Brotli size prefix");
+        const std::vector<std::uint8_t> brotliStream(prefixed.begin() + streamStart, prefixed.end());
+
+        std::vector<std::uint8_t> payload;
+        UQPack::internal::appendVarint(payload, 1ULL << 40);
+        payload.insert(payload.end(), brotliStream.begin(), brotliStream.end());
+        checkDecodeFails(forge(payload, UQPack::CompressionType::BROTLI, false), "Brotli prefix claiming 1 TiB");
+
+        payload.clear();
+        UQPack::internal::appendVarint(payload, data.size() / 2);
+        payload.insert(payload.end(), brotliStream.begin(), brotliStream.end());
+        checkThrows([&] { UQPack::decodeInternal(forge(payload, UQPack::CompressionType::BROTLI, false), compressionType); },
+                    "Brotli prefix smaller than the stream");
+
+        payload.clear();
+        UQPack::internal::appendVarint(payload, data.size() * 2);
+        payload.insert(payload.end(), brotliStream.begin(), brotliStream.end());
+        checkThrows([&] { UQPack::decodeInternal(forge(payload, UQPack::CompressionType::BROTLI, false), compressionType); },
+                    "Brotli prefix larger than the stream");
+
+        payload.assign(12, 0x80);
+        checkDecodeFails(forge(payload, UQPack::CompressionType::BROTLI, false), "unterminated Brotli prefix");
+    }
+
+    // Compression nibble 0x3: raw DEFLATE behind a size prefix
+    void deflate() {
+        const std::vector<std::uint8_t> data = sample();
+        for (int level : {0, 1, 6, 12}) {
+            for (int baseIndex : {0, 1, 2}) {
+                for (size_t blockSize : {size_t(0), size_t(128)}) {
+                    UQPack::EncodeOptions options;
+                    options.compressionType = UQPack::CompressionType::DEFLATE;
+                    options.deflateLevel = level;
+                    options.baseIndex = baseIndex;
+                    options.compressionBlockSize = blockSize;
+                    const std::string what = "DEFLATE level " + std::to_string(level) + " base " + std::to_string(baseIndex) +
+                                              " block size " + std::to_string(blockSize);
+                    const std::string token = roundTrip(data, options, what);
+                    check(token[2] == '3', what + ": compression flag");
+                    UQPack::CompressionType compressionType;
+                    UQPack::decodeInternal(token, compressionType);
+                    check(compressionType == UQPack::CompressionType::DEFLATE, what + ": reported codec");
+                }
+            }
+        }
+
+        const char* const stored[] = {
+            "PX30:xAJ1zDsKgDAQBcC7bK2wn8RNcgVL8RRWohYSvLtVEAOvHphKx3ZRoWVeR2FmpoH286YiT_2TeSPtyUMj60hEUCghoVBSRKGqolBjRqHmCYVmhkJzRmFg_8IX:Hp",
+            "PX31:1H4jgiaXW2Nt-63D.KSAZHRUNpAW.S13qta3WO-8oxyzJ4B62bC5QvIRnq-o15yXZkartJJsw.zNOlk4v_mYt5AugndY4Piuw~8yhzdYlJv~lBOHFRIt8U9T:Pq",
+        };
+        UQPack::CompressionType compressionType;
+        for (const char* token : stored) {
+            check(UQPack::decodeInternal(token, compressionType) == data, std::string("stored DEFLATE ") + std::string(token, 4));
+        }
+
+        UQPack::EncodeOptions options;
+        options.compressionType = UQPack::CompressionType::DEFLATE;
+        UQPack::Encoder encoder;
+        std::vector<std::uint8_t> prefixed = encoder.compressWithDeflate(data.data(), data.size(), options);
+        size_t streamStart = 0;
+        std::uint64_t recorded;
+        check(UQPack::internal::readVarint(prefixed.data(), prefixed.size(), streamStart, recorded) && recorded == data.size(), "DEFLATE size prefix");
+        const std::vector<std::uint8_t> deflateStream(prefixed.begin() + streamStart, prefixed.end());
+
+        std::vector<std::uint8_t> payload;
+        UQPack::internal::appendVarint(payload, 1u << 30);
+        payload.insert(payload.end(), deflateStream.begin(), deflateStream.end());
+        checkDecodeFails(forge(payload, UQPack::CompressionType::DEFLATE, false), "DEFLATE prefix claiming 1 GiB");
+
+        for (size_t size : {data.size() - 1, data.size() + 1}) {
+            payload.clear();
+            UQPack::internal::appendVarint(payload, size);
+            payload.insert(payload.end(), deflateStream.begin(), deflateStream.end());
+            checkThrows([&] { UQPack::decodeInternal(forge(payload, UQPack::CompressionType::DEFLATE, false), compressionType); },
+                        "DEFLATE prefix of " + std::to_string(size) + " bytes");
+        }
+
+        payload = prefixed;
+        payload[streamStart] |= 0x06; // block type 3, which does not exist
+        checkThrows([&] { UQPack::decodeInternal(forge(payload, UQPack::CompressionType::DEFLATE, false), compressionType); },
+                    "corrupt DEFLATE stream");
+
+        // 0x7 stays invalid, and DEFLATE takes no dictionary
+        const std::string token = forge(prefixed, UQPack::CompressionType::DEFLATE, false);
+        checkDecodeFails(withHeader(token, "PX70"), "compression flags 0x7");
+        checkDecodeFails(withHeader(token, "PXB01"), "DEFLATE with a dictionary");
+        options.dictionaryId = 1;
+        checkThrows([&] { encoder.compressWithDeflate(data.data(), data.size(), options); }, "DEFLATE compression with a dictionary");
+    }
+}
+
+int main() {
+    blockFrames();
+    brotliSizePrefix();
+    deflate();
+
+    if (failures != 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All wire format checks passed" << std::endl;
+    return 0;
+}
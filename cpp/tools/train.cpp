@@ -0,0 +1,265 @@
+#include <encode.hpp>
+#include <decode.hpp>
+#include <dictionary.hpp>
+#include <zdict.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Dictionary trainer: reads NDJSON samples, packs each document the way encode(json)
+// does (MessagePack), trains a dictionary per codec on most of them and reports the
+// compression ratio, token length and throughput with and without it on the rest.
+//
+// The Zstd dictionary is written in zstd's format and carries its id. The LZ4 and
+// Brotli ones are raw content (zstd's trainer puts the most useful segments last,
+// which is the part an LZ4 prefix can reach) and must be registered with their id:
+//     DictionaryRegistry::global().addFile(path, id);
+//
+// Usage: uqpack_train <samples.ndjson> [options]
+//   --out <prefix>       write <prefix>-zstd.dict, -lz4.dict and -brotli.dict (default: uqpack)
+//   --zstd-size <bytes>  dictionary size budgets (default: 4096 each; LZ4 uses at most 65536)
+//   --lz4-size <bytes>
+//   --brotli-size <bytes>
+//   --id <n>             id of the Zstd dictionary; LZ4 and Brotli get n+1 and n+2 (default: 32768)
+//   --holdout <k>        hold out every k-th sample for the report (default: 10)
+
+namespace {
+    struct Codec {
+        const char* name;
+        UQPack::CompressionType type;
+        size_t budget;
+        std::uint32_t id;
+        bool raw;
+    };
+
+    struct Result {
+        double ratio;
+        double tokenLength;
+        double encodeMBps;
+        double decodeMBps;
+    };
+
+    void writeFile(const std::string& path, const std::vector<std::uint8_t>& content) {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(content.data()), content.size());
+        if (!out) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+    // Dictionary of at most budget bytes in zstd's format, with the given id
+    std::vector<std::uint8_t> trainZstd(const std::vector<std::uint8_t>& samples, const std::vector<size_t>& sizes, size_t budget, std::uint32_t id) {
+        std::vector<std::uint8_t> trained(budget);
+        size_t size = ZDICT_trainFromBuffer(trained.data(), trained.size(), samples.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+        if (ZDICT_isError(size)) {
+            throw std::runtime_error(std::string("Dictionary training failed: ") + ZDICT_getErrorName(size));
+        }
+
+        // Re-finalize the trained content with the requested id
+        size_t headerSize = ZDICT_getDictHeaderSize(trained.data(), size);
+        if (ZDICT_isError(headerSize)) {
+            throw std::runtime_error("Trained dictionary has no valid header");
+        }
+        ZDICT_params_t params = {};
+        params.dictID = id;
+        std::vector<std::uint8_t> dictionary(budget);
+        size = ZDICT_finalizeDictionary(dictionary.data(), dictionary.size(), trained.data() + headerSize, size - headerSize,
+                                        samples.data(), sizes.data(), static_cast<unsigned>(sizes.size()), params);
+        if (ZDICT_isError(size)) {
+            throw std::runtime_error(std::string("Dictionary finalization failed: ") + ZDICT_getErrorName(size));
+        }
+        dictionary.resize(size);
+        return dictionary;
+    }
+
+    // Content of a zstd-format dictionary without its header and entropy tables
+    std::vector<std::uint8_t> rawContent(const std::vector<std::uint8_t>& dictionary) {
+        size_t headerSize = ZDICT_getDictHeaderSize(dictionary.data(), dictionary.size());
+        return std::vector<std::uint8_t>(dictionary.begin() + headerSize, dictionary.end());
+    }
+
+    Result measure(const std::vector<std::vector<std::uint8_t>>& heldOut, UQPack::CompressionType type, std::uint32_t dictionaryId) {
+        UQPack::Encoder encoder;
+        UQPack::Decoder decoder;
+        UQPack::EncodeOptions options;
+        options.compressionType = type;
+        options.dictionaryId = dictionaryId;
+
+        size_t inputBytes = 0;
+        size_t compressedBytes = 0;
+        size_t tokenChars = 0;
+        std::vector<std::string> tokens;
+        tokens.reserve(heldOut.size());
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& sample : heldOut) {
+            std::vector<std::uint8_t> compressed = encoder.compress(sample.data(), sample.size(), type, dictionaryId);
+            inputBytes += sample.size();
+            compressedBytes += compressed.size();
+            tokens.push_back(encoder.encode(compressed, options));
+            tokenChars += tokens.back().size();
+        }
+        double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < tokens.size(); i++) {
+            UQPack::CompressionType compressionType;
+            if (decoder.decodeInternal(tokens[i], compressionType) != heldOut[i]) {
+                throw std::runtime_error("Held-out sample " + std::to_string(i) + " did not round-trip");
+            }
+        }
+        double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        Result result;
+        result.ratio = static_cast<double>(inputBytes) / compressedBytes;
+        result.tokenLength = static_cast<double>(tokenChars) / heldOut.size();
+        result.encodeMBps = inputBytes / encodeSeconds / 1e6;
+        result.decodeMBps = inputBytes / decodeSeconds / 1e6;
+        return result;
+    }
+
+    // Parse a decimal count above zero, rejecting signs, trailing characters and overflow
+    bool parseCount(const char* text, size_t& count) {
+        if (!std::isdigit(static_cast<unsigned char>(*text))) {
+            return false;
+        }
+        char* end;
+        errno = 0;
+        const unsigned long long parsed = std::strtoull(text, &end, 10);
+        if (*end != '\0' || errno == ERANGE || parsed == 0 || parsed > std::numeric_limits<size_t>::max()) {
+            return false;
+        }
+        count = static_cast<size_t>(parsed);
+        return true;
+    }
+
+    void printRow(const Codec& codec, const char* dictionary, const Result& result) {
+        std::cout << std::left << std::setw(8) << codec.name << std::setw(10) << dictionary << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(7) << result.ratio
+                  << std::setprecision(1) << std::setw(11) << result.tokenLength
+                  << std::setw(11) << result.encodeMBps << std::setw(11) << result.decodeMBps << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    auto usage = [&] {
+        std::cerr << "Usage: " << argv[0] << " <samples.ndjson> [--out prefix] [--zstd-size n] [--lz4-size n] "
+                  << "[--brotli-size n] [--id n] [--holdout k]" << std::endl;
+        return 1;
+    };
+    if (argc < 2) {
+        return usage();
+    }
+
+    std::string out = "uqpack";
+    size_t zstdSize = 4096;
+    size_t lz4Size = 4096;
+    size_t brotliSize = 4096;
+    std::uint32_t id = 32768;
+    size_t holdout = 10;
+    for (int i = 2; i < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg != "--out" && arg != "--zstd-size" && arg != "--lz4-size" && arg != "--brotli-size" && arg != "--id" && arg != "--holdout") {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return usage();
+        }
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return usage();
+        }
+        const char* value = argv[i + 1];
+        if (arg == "--out") {
+            out = value;
+            continue;
+        }
+
+        // Every other option takes a count above zero; ids must leave room for id+2
+        size_t count;
+        if (!parseCount(value, count) || (arg == "--id" && count > std::numeric_limits<std::uint32_t>::max() - 2)) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return usage();
+        }
+        if (arg == "--zstd-size") {
+            zstdSize = count;
+        } else if (arg == "--lz4-size") {
+            lz4Size = std::min<size_t>(count, 64 * 1024);
+        } else if (arg == "--brotli-size") {
+            brotliSize = count;
+        } else if (arg == "--id") {
+            id = static_cast<std::uint32_t>(count);
+        } else {
+            holdout = std::max<size_t>(2, count);
+        }
+    }
+
+    try {
+        // Pack every document as encode(json) does; every holdout-th one is kept out of training
+        std::ifstream in(argv[1]);
+        if (!in) {
+            throw std::runtime_error(std::string("Cannot open ") + argv[1]);
+        }
+        std::vector<std::uint8_t> samples;
+        std::vector<size_t> sizes;
+        std::vector<std::vector<std::uint8_t>> heldOut;
+        std::string line;
+        for (size_t n = 0; std::getline(in, line); ) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::vector<std::uint8_t> packed = json::to_msgpack(json::parse(line));
+            if (++n % holdout == 0) {
+                heldOut.push_back(std::move(packed));
+            } else {
+                samples.insert(samples.end(), packed.begin(), packed.end());
+                sizes.push_back(packed.size());
+            }
+        }
+        if (heldOut.empty()) {
+            throw std::runtime_error("Not enough samples to hold any out");
+        }
+        std::cout << sizes.size() << " training samples (" << samples.size() << " bytes), "
+                  << heldOut.size() << " held out" << std::endl;
+
+        const Codec codecs[] = {
+            {"zstd", UQPack::CompressionType::ZSTD, zstdSize, id, false},
+            {"lz4", UQPack::CompressionType::LZ4, lz4Size, id + 1, true},
+            {"brotli", UQPack::CompressionType::BROTLI, brotliSize, id + 2, true},
+        };
+
+        for (const Codec& codec : codecs) {
+            std::vector<std::uint8_t> dictionary = trainZstd(samples, sizes, codec.budget, codec.id);
+            if (codec.raw) {
+                dictionary = rawContent(dictionary);
+            }
+            const std::string path = out + "-" + codec.name + ".dict";
+            writeFile(path, dictionary);
+            UQPack::DictionaryRegistry::global().addFile(path, codec.id);
+            std::cout << path << ": " << dictionary.size() << " bytes, id " << codec.id << std::endl;
+        }
+
+        std::cout << std::endl << "codec   dict        ratio  avg chars  enc MB/s   dec MB/s" << std::endl;
+        for (const Codec& codec : codecs) {
+            printRow(codec, "none", measure(heldOut, codec.type, 0));
+            #ifndef UQPACK_BROTLI_DICTIONARIES
+            if (codec.type == UQPack::CompressionType::BROTLI) {
+                std::cout << std::left << std::setw(8) << codec.name << std::setw(10) << "trained"
+                          << "(needs Brotli 1.1.0 or later)" << std::endl;
+                continue;
+            }
+            #endif
+            printRow(codec, "trained", measure(heldOut, codec.type, codec.id));
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}